@@ -0,0 +1,82 @@
+#include "bake_cache.h"
+
+using Core::BakeCache;
+
+BakeCache& BakeCache::instance() noexcept
+{
+	// Never destroyed, properties that are destroyed during exit still remove their samples from it
+	static auto cache = new BakeCache();
+	return *cache;
+}
+
+size_t BakeCache::budget() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return budget_;
+}
+
+void BakeCache::setBudget(size_t bytes) noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	budget_ = bytes;
+	trim();
+}
+
+int BakeCache::sampleRate() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return sampleRate_;
+}
+
+void BakeCache::setSampleRate(int samplesPerFrame) noexcept
+{
+	assert(samplesPerFrame > 0);
+	std::lock_guard<std::mutex> lock(mutex_);
+	sampleRate_ = samplesPerFrame;
+}
+
+size_t BakeCache::memoryUsage() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return memoryUsage_;
+}
+
+void BakeCache::insert(std::shared_ptr<const Entry> entry) noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	assert(!entry->cached_);
+
+	memoryUsage_ += entry->memoryUsage;
+	entry->cached_ = true;
+	entries_.emplace_front(entry);
+	entry->position_ = begin(entries_);
+	trim();
+}
+
+void BakeCache::touch(const Entry& entry) noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (entry.cached_) entries_.splice(begin(entries_), entries_, entry.position_);
+}
+
+void BakeCache::erase(const Entry& entry) noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!entry.cached_) return;
+
+	entry.cached_ = false;
+	memoryUsage_ -= entry.memoryUsage;
+	entries_.erase(entry.position_);
+}
+
+void BakeCache::trim() noexcept
+{
+	// Entries that are dropped here are only destroyed once no evaluation is using them anymore
+	while (memoryUsage_ > budget_ && !entries_.empty())
+	{
+		auto& entry = *entries_.back();
+		entry.cached_ = false;
+		memoryUsage_ -= entry.memoryUsage;
+		entries_.pop_back();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "static.h"
+#include <list>
+#include <mutex>
+
+BEGIN_NAMESPACE(Core)
+
+// Keeps the samples properties bake for dense evaluation within one memory budget for the whole process.
+// The least recently used samples are dropped first, their property bakes them again when it needs them.
+class BakeCache
+{
+public:
+	static const size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+	static const int DEFAULT_SAMPLE_RATE = 1; // samples per frame
+
+	struct Entry
+	{
+		virtual ~Entry() = default;
+		size_t memoryUsage {};
+
+	private:
+		friend class BakeCache;
+
+		// Guarded by the mutex of the cache
+		mutable std::list<std::shared_ptr<const Entry>>::iterator position_;
+		mutable bool cached_ {};
+	};
+
+	static BakeCache& instance() noexcept;
+
+	size_t budget() const noexcept;
+	void setBudget(size_t bytes) noexcept;
+
+	// Samples are taken at every frame that is a multiple of 1 / rate
+	int sampleRate() const noexcept;
+	void setSampleRate(int samplesPerFrame) noexcept;
+
+	size_t memoryUsage() const noexcept;
+
+	// Drops the least recently used entries until everything fits in the budget again
+	void insert(std::shared_ptr<const Entry> entry) noexcept;
+	void touch(const Entry& entry) noexcept;
+	void erase(const Entry& entry) noexcept;
+
+private:
+	BakeCache() = default;
+	void trim() noexcept;
+
+	mutable std::mutex mutex_;
+	std::list<std::shared_ptr<const Entry>> entries_; // most recently used first
+	size_t budget_ { DEFAULT_BUDGET };
+	int sampleRate_ { DEFAULT_SAMPLE_RATE };
+	size_t memoryUsage_ {};
+};
+
+END_NAMESPACE(Core)
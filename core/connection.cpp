@@ -75,13 +75,23 @@ void Connection::load(Archive& archive)
 	NodePtr inputNode;
 	ConnectorMetadataPtr input;
 	tie(outputNode, output, inputNode, input) = loaded;
+	if (!outputNode || !output || !inputNode || !input) throw cereal::Exception("Connection without both of its ends");
 
 	// Replace non-local connectors with the one from the global metadata repository
-	if (!output->isLocal()) output = *find_if(begin(outputNode->connectorMetadata()), end(outputNode->connectorMetadata()), [output](auto& c) { return c->hash() == output->hash(); });
-	if (!input->isLocal()) input = *find_if(begin(inputNode->connectorMetadata()), end(inputNode->connectorMetadata()), [input](auto& c) { return c->hash() == input->hash(); });
+	auto global = [](const NodePtr& node, const ConnectorMetadataPtr& metadata)
+	{
+		if (metadata->isLocal()) return metadata;
+		auto it = find_if(begin(node->connectorMetadata()), end(node->connectorMetadata()), [&](auto& c) { return c->hash() == metadata->hash(); });
+		if (it == end(node->connectorMetadata())) throw cereal::Exception("Connection to a connector the node doesn't have");
+		return *it;
+	};
+	output = global(outputNode, output);
+	input = global(inputNode, input);
 
 	impl_->connection_ = make_tuple(outputNode, output, inputNode, input);
 }
 
 template void Connection::save<cereal::JSONOutputArchive>(cereal::JSONOutputArchive& archive) const;
 template void Connection::load<cereal::JSONInputArchive>(cereal::JSONInputArchive& archive);
+template void Connection::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Connection::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
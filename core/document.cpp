@@ -1,5 +1,6 @@
 #include "document.h"
 #include "connection.h"
+#include <mutex>
 
 using Core::Document;
 using Core::Node;
@@ -8,42 +9,88 @@ using Core::Property;
 using Core::PropertyPtr;
 using Core::Connection;
 using Core::ConnectionPtr;
+using Core::MutableConnectionPtr;
+using Core::MutableNodePtr;
 using Core::HashValue;
 using Core::ConnectorMetadata;
+using Core::ConnectorMetadataPtr;
 using Core::visibility_t;
+using Core::Uuid;
+using Core::NodeTree;
+using Core::HashTrie;
 using Builder = Document::Builder;
+using Operation = Document::Operation;
 
 struct Document::Impl
 {
+	Impl() = default;
+	Impl(const Impl& rhs);
+
+	struct Owner
+	{
+		NodePtr node;
+		size_t index;
+	};
+
+	template <typename T>
+	using owners_t = std::unordered_map<const T*, Owner>;
+
+	void indexOwners() const noexcept;
+
 	tree_t nodes_;
-	connections_t connections_;
+	std::shared_ptr<const connections_t> connections_ { std::make_shared<connections_t>() }; // shared until a Builder changes it
+	HashTrie<Uuid, connections_t> nodeConnections_; // connections by input and output node
 	Settings settings_;
+
+	// cache, filled on demand, a document can be read from multiple threads at once
+	mutable std::once_flag ownersIndexed_;
+	mutable owners_t<Property> propertyOwners_;
+	mutable owners_t<ConnectorMetadata> connectorOwners_;
 };
 
+// Copying the tree is O(1), the caches are rebuilt on demand
+Document::Impl::Impl(const Impl& rhs)
+	: nodes_(rhs.nodes_)
+	, connections_(rhs.connections_)
+	, nodeConnections_(rhs.nodeConnections_)
+	, settings_(rhs.settings_)
+{}
+
+void Document::Impl::indexOwners() const noexcept
+{
+	std::call_once(ownersIndexed_, [this]()
+	{
+		// Shared connector metadata is owned by every node of a type, the first node in the tree wins
+		for (auto&& node : nodes_)
+		{
+			size_t index = 0;
+			for (auto&& p : node->properties()) propertyOwners_.emplace(p.get(), Owner { node, index++ });
+
+			index = 0;
+			for (auto&& c : node->connectorMetadata()) connectorOwners_.emplace(c.get(), Owner { node, index++ });
+		}
+	});
+}
+
 Document::Document()
-	: impl_(std::make_unique<Impl>())
 {
-	impl_->settings_.visibility = { 0.0f, 1000.0f };
+	auto impl = std::make_shared<Impl>();
+	impl->settings_.visibility = { 0.0f, 1000.0f };
+	impl_ = impl;
 }
 
 Document::~Document() = default;
 
-Document::Document(const Document& rhs)
-	: impl_(std::make_unique<Impl>(*rhs.impl_))
-{}
-
-Document& Document::operator=(const Document& rhs)
-{
-	*impl_ = *rhs.impl_;
-	return *this;
-}
+// Documents are immutable, so copies share their Impl
+Document::Document(const Document& rhs) = default;
+Document& Document::operator=(const Document& rhs) = default;
 
 Document::Document(Document&& rhs) = default;
 Document& Document::operator=(Document&& rhs) = default;
 
 const NodePtr& Document::root() const noexcept
 {
-	return *begin(impl_->nodes_);
+	return impl_->nodes_.root();
 }
 
 const Core::tree_t& Document::nodes() const noexcept
@@ -53,7 +100,7 @@ const Core::tree_t& Document::nodes() const noexcept
 
 const Document::connections_t& Document::connections() const noexcept
 {
-	return impl_->connections_;
+	return *impl_->connections_;
 }
 
 const Document::Settings Document::settings() const noexcept
@@ -63,104 +110,232 @@ const Document::Settings Document::settings() const noexcept
 
 NodePtr Document::parent(const Node& node) const noexcept
 {
-	auto it = iteratorFor(this->nodes(), node);
-	auto parent = tree_t::parent(it);
-	if (parent.node == nullptr) return nullptr; // root has no parent
-	return *parent;
+	return impl_->nodes_.parent(node.uuid());
 }
 
 NodePtr Document::parent(const Property& prop) const noexcept
 {
-	for (auto&& node: this->nodes())
-	{
-		auto it = find_if(cbegin(node->properties()), cend(node->properties()), [&](auto& p) { return p.get() == &prop; });
-		if (it != cend(node->properties())) return node;
-	}
-	return nullptr;
+	impl_->indexOwners();
+	auto it = impl_->propertyOwners_.find(&prop);
+	if (it == end(impl_->propertyOwners_)) return nullptr;
+	return it->second.node;
 }
 
 NodePtr Document::parent(const ConnectorMetadata& connectorMetadata) const noexcept
 {
-	for (auto&& node : this->nodes())
-	{
-		auto it = find_if(cbegin(node->connectorMetadata()), cend(node->connectorMetadata()), [&](auto& p) { return p.get() == &connectorMetadata; });
-		if (it != cend(node->connectorMetadata())) return node;
-	}
-	return nullptr;
+	impl_->indexOwners();
+	auto it = impl_->connectorOwners_.find(&connectorMetadata);
+	if (it == end(impl_->connectorOwners_)) return nullptr;
+	return it->second.node;
 }
 
 NodePtr Document::child(const Node& parent, size_t index) const noexcept
 {
 	assert(childCount(parent) > index);
-	auto it = iteratorFor(this->nodes(), parent);
-	return *tree_t::child(it, index);
+	return impl_->nodes_.child(parent.uuid(), index);
+}
+
+NodePtr Document::find(const Uuid& uuid) const noexcept
+{
+	return impl_->nodes_.find(uuid);
 }
 
 bool Document::exists(const Node& node) const noexcept
 {
-	return std::find_if(cbegin(this->nodes()), cend(this->nodes()), [&](auto& n) { return n.get() == &node; }) != cend(this->nodes());
+	return impl_->nodes_.find(node.uuid()).get() == &node;
 }
 
 size_t Document::childIndex(const Node& node) const noexcept
 {
-	auto it = iteratorFor(this->nodes(), node);
-	return this->nodes().index(it);
+	return impl_->nodes_.childIndex(node.uuid());
 }
 
 size_t Document::childIndex(const Property& prop) const noexcept
 {
-	auto node = parent(prop);
-	size_t index = 0;
-	for (auto&& p: node->properties())
-	{
-		if (p.get() == &prop) return index;
-		index++;
-	}
-	return -1;
+	impl_->indexOwners();
+	auto it = impl_->propertyOwners_.find(&prop);
+	if (it == end(impl_->propertyOwners_)) return -1;
+	return it->second.index;
 }
 
 size_t Document::childIndex(const ConnectorMetadata& connectorMetadata) const noexcept
 {
-	auto node = parent(connectorMetadata);
-	size_t index = 0;
-	for (auto&& p : node->connectorMetadata())
-	{
-		if (p.get() == &connectorMetadata) return index;
-		index++;
-	}
-	return -1;
+	impl_->indexOwners();
+	auto it = impl_->connectorOwners_.find(&connectorMetadata);
+	if (it == end(impl_->connectorOwners_)) return -1;
+	return it->second.index;
 }
 
 size_t Document::childCount(const Node& node) const noexcept
 {
-	return this->nodes().number_of_children(iteratorFor(this->nodes(), node));
+	return impl_->nodes_.childCount(node.uuid());
 }
 
 size_t Document::totalChildCount(const Node& node) const noexcept
 {
-	return this->nodes().size(iteratorFor(this->nodes(), node)) - 1; // - 1 because it includes the node itself
+	return impl_->nodes_.branch(node.uuid())->size - 1; // - 1 because it includes the node itself
 }
 
-Document Document::buildRootDocument(NodePtr root) noexcept
+bool Document::operator==(const Document& rhs) const noexcept
+{
+	if (impl_ == rhs.impl_) return true;
+
+	return impl_->nodes_ == rhs.impl_->nodes_
+		&& impl_->settings_.visibility == rhs.impl_->settings_.visibility
+		&& (impl_->connections_ == rhs.impl_->connections_ || *impl_->connections_ == *rhs.impl_->connections_);
+}
+
+static void addNodeConnection(HashTrie<Uuid, Document::connections_t>& nodeConnections, const Uuid& uuid, const ConnectionPtr& connection) noexcept;
+
+// Points a connection at the nodes in the tree with the same uuids, and at their connectors with the same hashes.
+// Nullptr if one of them doesn't exist, a journal read back from disk doesn't have to match the tree.
+static ConnectionPtr relink(const Core::tree_t& nodes, const ConnectionPtr& connection) noexcept
+{
+	NodePtr outputNode;
+	ConnectorMetadataPtr output;
+	NodePtr inputNode;
+	ConnectorMetadataPtr input;
+	tie(outputNode, output, inputNode, input) = connection->connection();
+	if (!outputNode || !output || !inputNode || !input) return nullptr;
+
+	auto connector = [](const NodePtr& node, const ConnectorMetadataPtr& metadata) -> ConnectorMetadataPtr
+	{
+		if (!node) return nullptr;
+		auto it = find_if(cbegin(node->connectorMetadata()), cend(node->connectorMetadata()), [&](auto& c) { return c->hash() == metadata->hash(); });
+		return it == cend(node->connectorMetadata()) ? nullptr : *it;
+	};
+
+	outputNode = nodes.find(outputNode->uuid());
+	inputNode = nodes.find(inputNode->uuid());
+	output = connector(outputNode, output);
+	input = connector(inputNode, input);
+	if (!output || !input) return nullptr;
+
+	auto con = make_tuple(outputNode, output, inputNode, input);
+	if (con == connection->connection()) return connection;
+	return std::make_shared<const Connection>(con);
+}
+
+Document Document::apply(const Delta& delta, bool inverse) const noexcept
 {
+	auto impl = std::make_shared<Impl>(*impl_);
+	impl->nodes_.apply(delta.edits, inverse);
+	impl->nodes_.seal();
+
+	if (delta.curConnections)
+	{
+		impl->connections_ = inverse ? delta.prevConnections : delta.curConnections;
+		impl->nodeConnections_ = inverse ? delta.prevNodeConnections : delta.curNodeConnections;
+	}
+
+	// Connections that were read back from disk don't point to the nodes in the tree yet, the ones that can't are dropped
+	if (delta.curConnections && delta.loaded)
+	{
+		auto connections = std::make_shared<connections_t>();
+		impl->nodeConnections_ = {};
+		for (auto&& con : *impl->connections_)
+		{
+			auto relinked = relink(impl->nodes_, con);
+			if (!relinked) continue;
+
+			connections->emplace_back(relinked);
+			addNodeConnection(impl->nodeConnections_, relinked->outputNode()->uuid(), relinked);
+			addNodeConnection(impl->nodeConnections_, relinked->inputNode()->uuid(), relinked);
+		}
+		impl->connections_ = connections;
+	}
+	impl->settings_ = inverse ? delta.prevSettings : delta.curSettings;
+
 	Document d;
-	d.impl_->nodes_.set_head(root);
+	d.impl_ = impl;
 	return d;
 }
 
-Core::tree_t::iterator Document::iteratorFor(const Core::tree_t& tree, const Node& node) noexcept
+void Document::Delta::append(const Delta& next)
 {
-	auto it = std::find_if(cbegin(tree), cend(tree), [&node](auto& n) { return n.get() == &node; });
-	assert(it != end(tree));
-	return it;
+	auto first = cbegin(next.edits);
+
+	// Scrubbing a value replaces the same node over and over, only the first and last version matter
+	if (!edits.empty() && first != cend(next.edits) && edits.back().type == tree_t::Edit::Type::Replace
+		&& first->type == tree_t::Edit::Type::Replace && first->uuid == edits.back().uuid)
+	{
+		edits.back().node = first->node;
+		++first;
+	}
+	edits.insert(end(edits), first, cend(next.edits));
+
+	if (next.curConnections)
+	{
+		if (!curConnections)
+		{
+			prevConnections = next.prevConnections;
+			prevNodeConnections = next.prevNodeConnections;
+		}
+		curConnections = next.curConnections;
+		curNodeConnections = next.curNodeConnections;
+	}
+	curSettings = next.curSettings;
+}
+
+static size_t memoryUsage(const Node& node) noexcept
+{
+	auto result = sizeof(Node) + node.connectorMetadata().size() * sizeof(ConnectorMetadataPtr);
+	for (auto&& prop : node.properties()) result += sizeof(PropertyPtr) + prop->memoryUsage();
+	return result;
+}
+
+static size_t memoryUsage(const NodeTree::Branch& branch) noexcept
+{
+	auto result = sizeof(NodeTree::Branch) + branch.children.capacity() * sizeof(NodeTree::BranchPtr) + memoryUsage(*branch.node);
+	for (auto&& child : branch.children) result += memoryUsage(*child);
+	return result;
+}
+
+size_t Document::Delta::memoryUsage() const noexcept
+{
+	auto result = sizeof(Delta) + edits.capacity() * sizeof(tree_t::Edit);
+
+	// The documents on both sides hold the inserted and current nodes, only what was replaced or erased is extra
+	for (auto&& edit : edits)
+	{
+		if (edit.previous) result += ::memoryUsage(*edit.previous);
+		if (edit.subtree) result += ::memoryUsage(*edit.subtree);
+	}
+
+	if (curConnections) result += (prevConnections->size() + curConnections->size()) * sizeof(ConnectionPtr);
+	return result;
+}
+
+Document Document::buildRootDocument(NodePtr root) noexcept
+{
+	auto impl = std::make_shared<Impl>();
+	impl->nodes_ = tree_t(root);
+	impl->settings_.visibility = { 0.0f, 1000.0f };
+
+	Document d;
+	d.impl_ = impl;
+	return d;
 }
 
 #ifdef _DEBUG
-#include <tree/tree_util.h>
+static void dumpBranch(const Core::NodeTree::Branch& branch)
+{
+	std::cout << branch.node;
+	if (branch.children.empty()) return;
+
+	std::cout << "(";
+	for (auto it = cbegin(branch.children); it != cend(branch.children); ++it)
+	{
+		if (it != cbegin(branch.children)) std::cout << ", ";
+		dumpBranch(**it);
+	}
+	std::cout << ")";
+}
 
 void Document::dumpTree() const
 {
-	print_tree_bracketed(impl_->nodes_);
+	dumpBranch(*impl_->nodes_.rootBranch());
+	std::cout << std::endl;
 }
 #endif
 
@@ -170,13 +345,77 @@ void Document::dumpTree() const
 
 struct Builder::BuilderImpl
 {
-	std::map<NodePtr, NodePtr> mutatedNodes_;
+	void touch(const Impl& impl, const std::vector<NodeTree::BranchPtr>& erased) noexcept;
+
+	void log(Operation::Type type, const Uuid& node, const Uuid& from = {}, const Uuid& to = {}) noexcept;
+	void log(Operation::Type type, const ConnectionPtr& connection) noexcept;
+
+	// nodes that were mutated or erased, and so might have connections that need fixing up
+	std::unordered_set<Uuid> touched_;
+	operations_t operations_;
+
+	// what the builder started from, and everything it did to the tree since
+	std::shared_ptr<const connections_t> connections_;
+	HashTrie<Uuid, connections_t> nodeConnections_;
+	Settings settings_;
+	tree_t::edits_t edits_;
 };
 
+void Builder::BuilderImpl::log(Operation::Type type, const Uuid& node, const Uuid& from, const Uuid& to) noexcept
+{
+	operations_.push_back({ type, node, from, to, nullptr });
+}
+
+void Builder::BuilderImpl::log(Operation::Type type, const ConnectionPtr& connection) noexcept
+{
+	operations_.push_back({ type, {}, {}, {}, connection });
+}
+
+void Builder::BuilderImpl::touch(const Impl& impl, const std::vector<NodeTree::BranchPtr>& erased) noexcept
+{
+	if (impl.nodeConnections_.empty()) return;
+
+	for (auto&& branch : erased)
+	{
+		touched_.emplace(branch->node->uuid());
+		touch(impl, branch->children);
+	}
+}
+
+static Document::connections_t& editableConnections(std::shared_ptr<const Document::connections_t>& connections) noexcept
+{
+	// Nobody else can see the connections if we're the only owner, so they can be changed in place
+	if (connections.use_count() != 1) connections = std::make_shared<Document::connections_t>(*connections);
+	return const_cast<Document::connections_t&>(*connections);
+}
+
+static void addNodeConnection(HashTrie<Uuid, Document::connections_t>& nodeConnections, const Uuid& uuid, const ConnectionPtr& connection) noexcept
+{
+	auto existing = nodeConnections.find(uuid);
+	auto connections = existing ? *existing : Document::connections_t();
+	connections.emplace_back(connection);
+	nodeConnections.set(uuid, std::move(connections));
+}
+
+static void removeNodeConnection(HashTrie<Uuid, Document::connections_t>& nodeConnections, const Uuid& uuid, const ConnectionPtr& connection) noexcept
+{
+	auto existing = nodeConnections.find(uuid);
+	if (!existing) return;
+
+	auto connections = *existing;
+	connections.erase(remove(begin(connections), end(connections), connection), end(connections));
+	if (connections.empty()) nodeConnections.erase(uuid);
+	else nodeConnections.set(uuid, std::move(connections));
+}
+
 Builder::Builder(const Document& d)
 	: impl_(std::make_unique<Impl>(*d.impl_))
 	, builderImpl_(std::make_unique<BuilderImpl>())
 {
+	builderImpl_->connections_ = impl_->connections_;
+	builderImpl_->nodeConnections_ = impl_->nodeConnections_;
+	builderImpl_->settings_ = impl_->settings_;
+	impl_->nodes_.record(&builderImpl_->edits_);
 }
 
 Builder::~Builder() = default;
@@ -184,12 +423,15 @@ Builder::~Builder() = default;
 Builder::Builder(const Builder& rhs)
 	: impl_(std::make_unique<Impl>(*rhs.impl_))
 	, builderImpl_(std::make_unique<BuilderImpl>(*rhs.builderImpl_))
-{}
+{
+	impl_->nodes_.record(&builderImpl_->edits_);
+}
 
 Builder& Builder::operator=(const Builder& rhs)
 {
-	*impl_ = *rhs.impl_;
+	impl_ = std::make_unique<Impl>(*rhs.impl_);
 	*builderImpl_ = *rhs.builderImpl_;
+	impl_->nodes_.record(&builderImpl_->edits_);
 	return *this;
 }
 
@@ -197,147 +439,246 @@ Builder::Builder(Builder&& rhs) = default;
 Builder& Builder::operator=(Builder&& rhs) = default;
 
 Document::Document(Builder&& rhs)
-	: impl_(move(rhs.impl_))
-{}
+{
+	*this = std::move(rhs);
+}
 
 Document& Document::operator=(Builder&& rhs)
 {
+	// From here on the tree is shared, make sure it is never edited in place again
+	rhs.impl_->nodes_.seal();
+	rhs.impl_->nodes_.record(nullptr);
 	impl_ = move(rhs.impl_);
 	return *this;
 }
 
 void Builder::mutate(NodePtr node, mutate_fn fn) const noexcept
 {
-	auto b = Node::Builder(*node);
+	// An earlier change through this builder may have replaced the node already, build on the latest version
+	auto current = impl_->nodes_.find(node->uuid());
+	assert(current);
+	auto b = Node::Builder(*current);
 	fn(b);
 
 	// Construct the new node
 	auto&& newNode = std::make_shared<Node>(std::move(b));
-	builderImpl_->mutatedNodes_[node] = newNode;
+	builderImpl_->touched_.emplace(node->uuid());
+	builderImpl_->log(Operation::Type::Mutate, node->uuid());
 
 	// Replace it in the tree
-	auto pos = find(begin(impl_->nodes_), end(impl_->nodes_), node);
-	assert(pos != end(impl_->nodes_));
-	impl_->nodes_.replace(pos, newNode);
+	assert(newNode->uuid() == node->uuid());
+	impl_->nodes_.replace(newNode);
 }
 
 void Builder::mutateSettings(const Document::Settings newSettings) noexcept
 {
 	impl_->settings_ = newSettings;
+	builderImpl_->log(Operation::Type::Settings, Uuid());
 }
 
 void Builder::fixupConnections() const
 {
-	connections_t fixed;
-
-	// Replace it in the connections
-	for (auto& conPtr: impl_->connections_)
+	// Only connections of nodes that were mutated or erased can be out of date
+	std::unordered_map<ConnectionPtr, ConnectionPtr> fixed;
+	for (auto&& uuid : builderImpl_->touched_)
 	{
-		NodePtr outputNode;
-		ConnectorMetadataPtr output;
-		NodePtr inputNode;
-		ConnectorMetadataPtr input;
-		tie(outputNode, output, inputNode, input) = conPtr->connection();
+		auto connections = impl_->nodeConnections_.find(uuid);
+		if (!connections) continue;
 
-		// Has the output or input node mutated?
-		auto hasMutated = builderImpl_->mutatedNodes_.find(outputNode);
-		if (hasMutated != end(builderImpl_->mutatedNodes_)) outputNode = hasMutated->second;
+		for (auto&& conPtr : *connections)
+		{
+			if (fixed.count(conPtr)) continue;
+
+			NodePtr outputNode;
+			ConnectorMetadataPtr output;
+			NodePtr inputNode;
+			ConnectorMetadataPtr input;
+			tie(outputNode, output, inputNode, input) = conPtr->connection();
+
+			// Has the output or input node been deleted?
+			outputNode = impl_->nodes_.find(outputNode->uuid());
+			inputNode = impl_->nodes_.find(inputNode->uuid());
+			if (!outputNode || !inputNode)
+			{
+				fixed[conPtr] = nullptr;
+				continue;
+			}
+
+			// Has the output or input node mutated?
+			auto con = make_tuple(outputNode, output, inputNode, input);
+			if (con != conPtr->connection()) fixed[conPtr] = std::make_shared<const Connection>(con);
+		}
+	}
+	builderImpl_->touched_.clear();
 
-		hasMutated = builderImpl_->mutatedNodes_.find(inputNode);
-		if (hasMutated != end(builderImpl_->mutatedNodes_)) inputNode = hasMutated->second;
+	if (fixed.empty()) return;
 
-		// Has the output or input node been deleted?
-		if (find(begin(impl_->nodes_), end(impl_->nodes_), outputNode) == end(impl_->nodes_)) continue;
-		if (find(begin(impl_->nodes_), end(impl_->nodes_), inputNode) == end(impl_->nodes_)) continue;
+	// Logged in the order of the connections rather than the order of the map, so every run logs the same operations
+	auto& connections = editableConnections(impl_->connections_);
+	for (auto&& conPtr : connections)
+	{
+		auto it = fixed.find(conPtr);
+		if (it == end(fixed)) continue;
 
-		auto con = make_tuple(outputNode, output, inputNode, input);
-		if (con != conPtr->connection())
-		{
-			fixed.emplace_back(std::make_shared<const Connection>(con));
-		}
-		else
-		{
-			fixed.emplace_back(conPtr);
-		}
+		removeNodeConnection(impl_->nodeConnections_, conPtr->outputNode()->uuid(), conPtr);
+		removeNodeConnection(impl_->nodeConnections_, conPtr->inputNode()->uuid(), conPtr);
+		builderImpl_->log(Operation::Type::Disconnect, conPtr);
+		if (!it->second) continue;
+
+		builderImpl_->log(Operation::Type::Connect, it->second);
+		addNodeConnection(impl_->nodeConnections_, it->second->outputNode()->uuid(), it->second);
+		addNodeConnection(impl_->nodeConnections_, it->second->inputNode()->uuid(), it->second);
 	}
 
-	impl_->connections_ = fixed;
+	// Replace them in the connections
+	auto last = remove_if(begin(connections), end(connections), [&](auto& conPtr)
+	{
+		auto it = fixed.find(conPtr);
+		if (it == end(fixed)) return false;
+		if (!it->second) return true;
+		conPtr = it->second;
+		return false;
+	});
+	connections.erase(last, end(connections));
 }
 
 void Builder::insertBefore(NodePtr before, std::initializer_list<NodePtr> nodes) noexcept
 {
-	assert(before);
-	auto beforePos = iteratorFor(impl_->nodes_, *before);
-
-	for (auto&& node : nodes)
-	{
-		impl_->nodes_.insert(beforePos, node);
-		auto nodePos = iteratorFor(impl_->nodes_, *node);
-		beforePos = nodePos;
-	}
+	insertBefore(before, std::vector<NodePtr>(nodes));
 }
 
 void Builder::append(std::initializer_list<NodePtr> nodes) noexcept
 {
-	append(*impl_->nodes_.begin(), nodes);
+	append(std::vector<NodePtr>(nodes));
 }
 
 void Builder::append(NodePtr parent, std::initializer_list<NodePtr> nodes) noexcept
 {
-	assert(parent);
-	auto parentPos = iteratorFor(impl_->nodes_, *parent);
-
-	for (auto&& node : nodes)
-	{
-		impl_->nodes_.append_child(parentPos, node);
-	}
+	append(parent, std::vector<NodePtr>(nodes));
 }
 
 void Builder::moveAfter(NodePtr after, std::initializer_list<NodePtr> nodes) noexcept
 {
-	assert(after);
-	auto afterPos = iteratorFor(impl_->nodes_, *after);
-
-	for (auto&& node : nodes)
-	{
-		auto nodePos = iteratorFor(impl_->nodes_, *node);
-		impl_->nodes_.move_after(afterPos, nodePos);
-		afterPos = nodePos;
-	}
+	moveAfter(after, std::vector<NodePtr>(nodes));
 }
 
 void Builder::erase(std::initializer_list<NodePtr> nodes) noexcept
 {
-	for (auto&& node : nodes)
-	{
-		auto pos = find(begin(impl_->nodes_), end(impl_->nodes_), node);
-		assert(pos != end(impl_->nodes_));
-		impl_->nodes_.erase(pos);
-	}
+	erase(std::vector<NodePtr>(nodes));
 }
 
 void Builder::eraseChildren(std::initializer_list<NodePtr> nodes) noexcept
 {
-	for (auto&& node : nodes) impl_->nodes_.erase_children(find(begin(impl_->nodes_), end(impl_->nodes_), node));
+	eraseChildren(std::vector<NodePtr>(nodes));
 }
 
 void Builder::reparent(NodePtr parent, std::initializer_list<NodePtr> nodes) noexcept
 {
-	auto parentPos = iteratorFor(impl_->nodes_, *parent);
+	reparent(parent, std::vector<NodePtr>(nodes));
+}
 
-	for (auto&& node: nodes)
-	{
-		auto it = iteratorFor(impl_->nodes_, *node);
-		impl_->nodes_.reparent(parentPos, it, impl_->nodes_.next_sibling(it));
+static std::vector<Uuid> uuids(const std::vector<NodePtr>& nodes) noexcept
+{
+	std::vector<Uuid> result;
+	result.reserve(nodes.size());
+	for (auto&& node : nodes) result.emplace_back(node->uuid());
+	return result;
+}
 
-		// Sanity check
-		assert((*tree_t::parent(it)).get() == parent.get());
+void Builder::insertBefore(NodePtr before, const std::vector<NodePtr>& nodes) noexcept
+{
+	assert(before);
+	auto parent = impl_->nodes_.parent(before->uuid())->uuid();
+	auto index = impl_->nodes_.childIndex(before->uuid());
+
+	// Every node goes right in front of the previously inserted one
+	impl_->nodes_.insert(parent, index, std::vector<NodePtr>(nodes.rbegin(), nodes.rend()));
+	for (auto&& node : nodes) builderImpl_->log(Operation::Type::Insert, node->uuid(), {}, parent);
+}
+
+void Builder::append(const std::vector<NodePtr>& nodes) noexcept
+{
+	append(impl_->nodes_.root(), nodes);
+}
+
+void Builder::append(NodePtr parent, const std::vector<NodePtr>& nodes) noexcept
+{
+	assert(parent);
+	impl_->nodes_.insert(parent->uuid(), tree_t::npos, nodes);
+	for (auto&& node : nodes) builderImpl_->log(Operation::Type::Insert, node->uuid(), {}, parent->uuid());
+}
+
+void Builder::moveAfter(NodePtr after, const std::vector<NodePtr>& nodes) noexcept
+{
+	assert(after);
+	auto parent = impl_->nodes_.parent(after->uuid())->uuid();
+	for (auto&& node : nodes) builderImpl_->log(Operation::Type::Move, node->uuid(), impl_->nodes_.parent(node->uuid())->uuid(), parent);
+	impl_->nodes_.moveAfter(uuids(nodes), after->uuid());
+}
+
+void Builder::erase(const std::vector<NodePtr>& nodes) noexcept
+{
+	for (auto&& node : nodes) builderImpl_->log(Operation::Type::Erase, node->uuid(), impl_->nodes_.parent(node->uuid())->uuid());
+	builderImpl_->touch(*impl_, impl_->nodes_.erase(uuids(nodes)));
+}
+
+void Builder::eraseChildren(const std::vector<NodePtr>& nodes) noexcept
+{
+	for (auto&& node : nodes)
+	{
+		auto children = impl_->nodes_.eraseChildren(node->uuid());
+		for (auto&& child : children) builderImpl_->log(Operation::Type::Erase, child->node->uuid(), node->uuid());
+		builderImpl_->touch(*impl_, children);
 	}
 }
 
+void Builder::reparent(NodePtr parent, const std::vector<NodePtr>& nodes) noexcept
+{
+	assert(parent);
+	for (auto&& node : nodes) builderImpl_->log(Operation::Type::Move, node->uuid(), impl_->nodes_.parent(node->uuid())->uuid(), parent->uuid());
+	impl_->nodes_.move(uuids(nodes), parent->uuid(), tree_t::npos);
+
+	// Sanity check
+	assert(all_of(cbegin(nodes), cend(nodes), [&](auto& node) { return impl_->nodes_.parent(node->uuid()).get() == parent.get(); }));
+}
+
 void Builder::connect(ConnectionPtr connection)
 {
-	impl_->connections_.emplace_back(connection);
+	editableConnections(impl_->connections_).emplace_back(connection);
+	addNodeConnection(impl_->nodeConnections_, connection->outputNode()->uuid(), connection);
+	addNodeConnection(impl_->nodeConnections_, connection->inputNode()->uuid(), connection);
+	builderImpl_->log(Operation::Type::Connect, connection);
+}
+
+const Core::tree_t& Builder::nodes() const noexcept
+{
+	return impl_->nodes_;
+}
+
+NodePtr Builder::find(const Uuid& uuid) const noexcept
+{
+	return impl_->nodes_.find(uuid);
+}
+
+const Document::operations_t& Builder::operations() const noexcept
+{
+	return builderImpl_->operations_;
+}
+
+Document::Delta Builder::delta() const noexcept
+{
+	Delta result;
+	result.edits = builderImpl_->edits_;
+	if (impl_->connections_ != builderImpl_->connections_)
+	{
+		result.prevConnections = builderImpl_->connections_;
+		result.curConnections = impl_->connections_;
+		result.prevNodeConnections = builderImpl_->nodeConnections_;
+		result.curNodeConnections = impl_->nodeConnections_;
+	}
+	result.prevSettings = builderImpl_->settings_;
+	result.curSettings = impl_->settings_;
+	return result;
 }
 
 ///
@@ -351,17 +692,19 @@ void Document::save(Archive& archive) const
 	archive(*it++);
 
 	std::vector<std::pair<NodePtr, NodePtr>> nodes;
-	std::for_each(it, end(impl_->nodes_), [&](auto& node) { nodes.emplace_back(std::make_pair(this->parent(*node), node)); });
+	std::for_each(it, impl_->nodes_.end(), [&](auto& node) { nodes.emplace_back(std::make_pair(this->parent(*node), node)); });
 	archive(nodes);
-	archive(impl_->connections_);
+	archive(*impl_->connections_);
 }
 
 template<class Archive>
 void Document::load(Archive& archive)
 {
+	auto impl = std::make_shared<Impl>(*impl_);
+
 	MutableNodePtr root;
 	archive(root);
-	impl_->nodes_.set_head(root);
+	impl->nodes_ = tree_t(root);
 
 	std::vector<std::pair<MutableNodePtr, MutableNodePtr>> nodes;
 	archive(nodes);
@@ -370,18 +713,105 @@ void Document::load(Archive& archive)
 	{
 		auto&& parent = kvp.first;
 		auto&& child = kvp.second;
-		impl_->nodes_.insert(end(impl_->nodes_), child);
-
-		auto parentPos = iteratorFor(impl_->nodes_, *parent);
-		auto it = iteratorFor(impl_->nodes_, *child);
-		impl_->nodes_.reparent(parentPos, it, impl_->nodes_.next_sibling(it));
+		impl->nodes_.insert(parent->uuid(), tree_t::npos, NodePtr(child));
 	}
+	impl->nodes_.seal();
 
 	std::vector<MutableConnectionPtr> connections;
 	archive(connections);
-	for (auto&& con : connections) impl_->connections_.emplace_back(con);
+	auto& target = editableConnections(impl->connections_);
+	for (auto&& con : connections)
+	{
+		target.emplace_back(con);
+		addNodeConnection(impl->nodeConnections_, con->outputNode()->uuid(), con);
+		addNodeConnection(impl->nodeConnections_, con->inputNode()->uuid(), con);
+	}
+
+	impl_ = impl;
 }
 
 template void Document::save<cereal::JSONOutputArchive>(cereal::JSONOutputArchive& archive) const;
 template void Document::load<cereal::JSONInputArchive>(cereal::JSONInputArchive& archive);
+template void Document::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Document::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
+
+template<class Archive>
+void Operation::save(Archive& archive) const
+{
+	archive(type);
+	archive(node);
+	archive(from);
+	archive(to);
+	archive(connection);
+}
+
+template<class Archive>
+void Operation::load(Archive& archive)
+{
+	archive(type);
+	archive(node);
+	archive(from);
+	archive(to);
+
+	MutableConnectionPtr connection;
+	archive(connection);
+	this->connection = connection;
+}
+
+template void Operation::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Operation::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
+
+template<class Archive>
+void Document::Delta::save(Archive& archive) const
+{
+	archive(edits);
+
+	archive(curConnections != nullptr);
+	if (curConnections)
+	{
+		archive(*prevConnections);
+		archive(*curConnections);
+	}
+
+	archive(prevSettings.visibility);
+	archive(curSettings.visibility);
+}
+
+// The connections by node aren't stored, they follow from the connections
+template<class Archive>
+static void loadConnections(Archive& archive, std::shared_ptr<const Document::connections_t>& connections, HashTrie<Uuid, Document::connections_t>& nodeConnections)
+{
+	std::vector<MutableConnectionPtr> loaded;
+	archive(loaded);
+
+	auto target = std::make_shared<Document::connections_t>();
+	for (auto&& con : loaded)
+	{
+		target->emplace_back(con);
+		addNodeConnection(nodeConnections, con->outputNode()->uuid(), con);
+		addNodeConnection(nodeConnections, con->inputNode()->uuid(), con);
+	}
+	connections = target;
+}
+
+template<class Archive>
+void Document::Delta::load(Archive& archive)
+{
+	archive(edits);
+
+	bool hasConnections;
+	archive(hasConnections);
+	if (hasConnections)
+	{
+		loadConnections(archive, prevConnections, prevNodeConnections);
+		loadConnections(archive, curConnections, curNodeConnections);
+	}
+
+	archive(prevSettings.visibility);
+	archive(curSettings.visibility);
+	loaded = true;
+}
+
+template void Document::Delta::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Document::Delta::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "static.h"
 #include "node.h"
+#include "node_tree.h"
 
 BEGIN_NAMESPACE(Core)
 
@@ -14,6 +15,46 @@ public:
 		visibility_t visibility;
 	};
 
+	// A single change made through a Builder, the log of these tells which parts of a document changed
+	struct Operation
+	{
+		enum class Type { Insert, Erase, Move, Mutate, Connect, Disconnect, Settings };
+
+		Type type;
+		Uuid node; // the node that was inserted, erased, moved or mutated
+		Uuid from; // parent the node was erased or moved from
+		Uuid to; // parent the node was inserted or moved into
+		ConnectionPtr connection;
+
+		template<class Archive> void save(Archive& archive) const;
+		template<class Archive> void load(Archive& archive);
+	};
+	using operations_t = std::vector<Operation>;
+
+	// Everything a Builder changed, enough to turn the document it started from into the one it produced and back
+	struct Delta
+	{
+		tree_t::edits_t edits;
+
+		// Only set when the connections changed, these are shared with the documents on either side
+		std::shared_ptr<const connections_t> prevConnections, curConnections;
+		HashTrie<Uuid, connections_t> prevNodeConnections, curNodeConnections;
+
+		Settings prevSettings, curSettings;
+
+		bool loaded {}; // read back from disk, so its nodes and connections are copies
+
+		// Continues this delta with one that starts where this one ends
+		void append(const Delta& next);
+
+		// Estimate of the bytes held by this delta that the documents it connects don't necessarily hold
+		size_t memoryUsage() const noexcept;
+
+		// Nodes and connections come back as copies, so they compare by content rather than identity afterwards
+		template<class Archive> void save(Archive& archive) const;
+		template<class Archive> void load(Archive& archive);
+	};
+
 private:
 	struct Impl;
 
@@ -36,6 +77,7 @@ public:
 	NodePtr parent(const Property& prop) const noexcept;
 	NodePtr parent(const ConnectorMetadata& connectorMetadata) const noexcept;
 	NodePtr child(const Node& parent, size_t index) const noexcept;
+	NodePtr find(const Uuid& uuid) const noexcept;
 	bool exists(const Node& node) const noexcept;
 	size_t childIndex(const Node& node) const noexcept;
 	size_t childIndex(const Property& prop) const noexcept;
@@ -43,6 +85,13 @@ public:
 	size_t childCount(const Node& node) const noexcept;
 	size_t totalChildCount(const Node& node) const noexcept;
 
+	// Compares the node hierarchy by hash, so this is O(1) unless the connections differ in identity
+	bool operator==(const Document& rhs) const noexcept;
+	bool operator!=(const Document& rhs) const noexcept { return !(*this == rhs); }
+
+	// Replays a delta on the document it started from, or with inverse on the document it produced
+	Document apply(const Delta& delta, bool inverse = false) const noexcept;
+
 	class Builder
 	{
 		struct BuilderImpl;
@@ -71,10 +120,34 @@ public:
 		void eraseChildren(std::initializer_list<NodePtr> nodes) noexcept;
 		void reparent(NodePtr parent, std::initializer_list<NodePtr> nodes) noexcept;
 
+		// Bulk versions, every call touches the tree once regardless of the number of nodes
+		void insertBefore(NodePtr before, const std::vector<NodePtr>& nodes) noexcept;
+		void append(const std::vector<NodePtr>& nodes) noexcept;
+		void append(NodePtr parent, const std::vector<NodePtr>& nodes) noexcept;
+		void moveAfter(NodePtr after, const std::vector<NodePtr>& nodes) noexcept;
+
+		void erase(const std::vector<NodePtr>& nodes) noexcept;
+		void eraseChildren(const std::vector<NodePtr>& nodes) noexcept;
+		void reparent(NodePtr parent, const std::vector<NodePtr>& nodes) noexcept;
+
+		template <typename It> void insertBefore(NodePtr before, It first, It last) noexcept { insertBefore(before, std::vector<NodePtr>(first, last)); }
+		template <typename It> void append(NodePtr parent, It first, It last) noexcept { append(parent, std::vector<NodePtr>(first, last)); }
+		template <typename It> void moveAfter(NodePtr after, It first, It last) noexcept { moveAfter(after, std::vector<NodePtr>(first, last)); }
+		template <typename It> void erase(It first, It last) noexcept { erase(std::vector<NodePtr>(first, last)); }
+		template <typename It> void eraseChildren(It first, It last) noexcept { eraseChildren(std::vector<NodePtr>(first, last)); }
+		template <typename It> void reparent(NodePtr parent, It first, It last) noexcept { reparent(parent, std::vector<NodePtr>(first, last)); }
+
 		void connect(ConnectionPtr connection);
 
 		void fixupConnections() const;
 
+		// The document as edited so far
+		const tree_t& nodes() const noexcept;
+		NodePtr find(const Uuid& uuid) const noexcept;
+
+		const operations_t& operations() const noexcept;
+		Delta delta() const noexcept;
+
 	private:
 		Builder() = default;
 		friend class Document;
@@ -97,8 +170,7 @@ private:
 	template<class Archive> void save(Archive& archive) const;
 	template<class Archive>	void load(Archive& archive);
 
-	static tree_t::iterator iteratorFor(const tree_t& tree, const Node& node) noexcept;
-	std::unique_ptr<Impl> impl_;
+	std::shared_ptr<const Impl> impl_;
 };
 
 END_NAMESPACE(Core)
\ No newline at end of file
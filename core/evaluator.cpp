@@ -0,0 +1,479 @@
+#include "evaluator.h"
+#include "interpolation.h"
+#include "metadata.h"
+#include "node.h"
+#include "parallel.h"
+#include "property.h"
+
+using Core::Document;
+using Core::Evaluator;
+using Core::Frame;
+using Core::HashValue;
+using Core::MutationInfo;
+using Core::Property;
+using Core::Segment;
+using Core::Uuid;
+
+namespace {
+
+// Every frame evaluates all properties of the document, so even a few of them are worth a thread
+const size_t PARALLEL_EVALUATE_GRAIN_SIZE = 4;
+
+// How a value is split into lanes of a single type
+template <typename T>
+struct Lanes
+{
+	using lane_t = T;
+	static const size_t count = 1;
+	static const lane_t* of(const T& value) noexcept { return &value; }
+};
+
+template <>
+struct Lanes<glm::vec2>
+{
+	using lane_t = float;
+	static const size_t count = 2;
+	static const lane_t* of(const glm::vec2& value) noexcept { return &value.x; }
+};
+
+template <>
+struct Lanes<glm::vec3>
+{
+	using lane_t = float;
+	static const size_t count = 3;
+	static const lane_t* of(const glm::vec3& value) noexcept { return &value.x; }
+};
+
+// A plain loop over contiguous arrays, so the compiler can turn it into SIMD instructions
+template <typename S, typename C>
+void interpolateLanes(const C* a0, const C* a1, const C* a2, const C* a3, const float* alphas, S* out, size_t count) noexcept
+{
+	for (size_t t = 0; t < count; t++) out[t] = Segment<S>::interpolate(a0[t], a1[t], a2[t], a3[t], alphas[t]);
+}
+
+// The keys of every property whose values are made of lanes of type S, back to back.
+// Coefficients are kept per segment and lane, in separate arrays for each of them.
+template <typename S>
+class Table
+{
+public:
+	using coefficient_t = typename Segment<S>::coefficient_t;
+
+	struct Channel
+	{
+		size_t firstKey;
+		size_t keys;
+		size_t firstValue; // keys * lanes of them, the lanes of a key next to each other
+		size_t firstSegment; // (keys - 1) * lanes of them
+		size_t lane; // offset in the result
+		size_t lanes;
+		bool live;
+	};
+
+	struct Scratch
+	{
+		std::vector<size_t> hints; // per channel
+		std::vector<size_t> targets;
+		std::vector<size_t> segments;
+		std::vector<float> alphas;
+		std::vector<coefficient_t> a0, a1, a2, a3;
+		std::vector<S> values;
+	};
+
+	template <typename T>
+	size_t add(const Property& property) noexcept
+	{
+		Channel channel {};
+		channel.lane = lanes_;
+		channel.lanes = Lanes<T>::count;
+		channel.live = true;
+		lanes_ += channel.lanes;
+
+		compile<T>(channel, property);
+		channels_.emplace_back(channel);
+		return channels_.size() - 1;
+	}
+
+	// The old keys stay behind until the tables are compiled from scratch
+	template <typename T>
+	void replace(size_t index, const Property& property) noexcept
+	{
+		garbage_ += channels_[index].keys;
+		compile<T>(channels_[index], property);
+	}
+
+	void remove(size_t index) noexcept
+	{
+		auto& channel = channels_[index];
+		garbage_ += channel.keys + channel.lanes;
+		channel.live = false;
+	}
+
+	const Channel& channel(size_t index) const noexcept { return channels_[index]; }
+	size_t lanes() const noexcept { return lanes_; }
+	bool wasteful() const noexcept { return garbage_ * 2 > frames_.size() + lanes_; }
+
+	void evaluate(Frame frame, S* out, Scratch& scratch) const noexcept
+	{
+		scratch.hints.resize(channels_.size());
+		scratch.targets.clear();
+		scratch.segments.clear();
+		scratch.alphas.clear();
+
+		// Finding the segments branches a lot, so this only collects the lanes that need interpolating
+		for (size_t c = 0; c < channels_.size(); c++)
+		{
+			auto& channel = channels_[c];
+			if (!channel.live) continue;
+
+			auto frames = &frames_[channel.firstKey];
+			auto next = scratch.hints[c] = Core::seek(frames, channel.keys, scratch.hints[c], frame);
+
+			// Before the first key, at or beyond the last one, or right on a key
+			if (!next || next == channel.keys || frames[next - 1] == frame)
+			{
+				auto key = next ? next - 1 : 0;
+				std::copy_n(&values_[channel.firstValue + key * channel.lanes], channel.lanes, out + channel.lane);
+				continue;
+			}
+
+			auto alpha = (frame - frames[next - 1]) / (frames[next] - frames[next - 1]);
+			for (size_t lane = 0; lane < channel.lanes; lane++)
+			{
+				scratch.targets.emplace_back(channel.lane + lane);
+				scratch.segments.emplace_back(channel.firstSegment + (next - 1) * channel.lanes + lane);
+				scratch.alphas.emplace_back(alpha);
+			}
+		}
+
+		auto count = scratch.targets.size();
+		scratch.a0.resize(count);
+		scratch.a1.resize(count);
+		scratch.a2.resize(count);
+		scratch.a3.resize(count);
+		scratch.values.resize(count);
+		for (size_t t = 0; t < count; t++)
+		{
+			auto segment = scratch.segments[t];
+			scratch.a0[t] = a0_[segment];
+			scratch.a1[t] = a1_[segment];
+			scratch.a2[t] = a2_[segment];
+			scratch.a3[t] = a3_[segment];
+		}
+
+		interpolateLanes(scratch.a0.data(), scratch.a1.data(), scratch.a2.data(), scratch.a3.data(), scratch.alphas.data(), scratch.values.data(), count);
+		for (size_t t = 0; t < count; t++) out[scratch.targets[t]] = scratch.values[t];
+	}
+
+private:
+	template <typename T>
+	void compile(Channel& channel, const Property& property) noexcept
+	{
+		// A property without keys has its default value everywhere, as if that were its only key
+		const Frame origin = 0;
+		auto& keys = property.keys();
+		auto frames = keys.empty() ? &origin : keys.data();
+		auto count = std::max<size_t>(keys.size(), 1);
+
+		std::vector<T> values(count);
+		property.evaluate(frames, count, values.data());
+
+		channel.firstKey = frames_.size();
+		channel.keys = count;
+		channel.firstValue = values_.size();
+		channel.firstSegment = a0_.size();
+
+		frames_.insert(end(frames_), frames, frames + count);
+		for (auto&& value : values)
+		{
+			auto lanes = Lanes<T>::of(value);
+			values_.insert(end(values_), lanes, lanes + channel.lanes);
+		}
+
+		for (size_t key = 0; key + 1 < count; key++)
+		{
+			for (size_t lane = 0; lane < channel.lanes; lane++)
+			{
+				Segment<S> segment(Lanes<T>::of(values[key])[lane], Lanes<T>::of(values[key + 1])[lane]);
+				a0_.emplace_back(segment.a0);
+				a1_.emplace_back(segment.a1);
+				a2_.emplace_back(segment.a2);
+				a3_.emplace_back(segment.a3);
+			}
+		}
+	}
+
+	std::vector<Channel> channels_;
+	std::vector<Frame> frames_;
+	std::vector<S> values_;
+	std::vector<coefficient_t> a0_, a1_, a2_, a3_;
+	size_t lanes_ {};
+	size_t garbage_ {}; // keys and lanes of channels that were replaced or removed
+};
+
+// Strings hold until the next key, so they only need the segment lookup
+class StringTable
+{
+public:
+	size_t add(const Property& property) noexcept
+	{
+		channels_.push_back({});
+		channels_.back().live = true;
+		compile(channels_.back(), property);
+		return channels_.size() - 1;
+	}
+
+	void replace(size_t index, const Property& property) noexcept
+	{
+		garbage_ += channels_[index].keys;
+		compile(channels_[index], property);
+	}
+
+	void remove(size_t index) noexcept
+	{
+		garbage_ += channels_[index].keys + 1;
+		channels_[index].live = false;
+	}
+
+	size_t slots() const noexcept { return channels_.size(); }
+	bool wasteful() const noexcept { return garbage_ * 2 > frames_.size() + channels_.size(); }
+
+	void evaluate(Frame frame, std::string* out, std::vector<size_t>& hints) const noexcept
+	{
+		hints.resize(channels_.size());
+		for (size_t c = 0; c < channels_.size(); c++)
+		{
+			auto& channel = channels_[c];
+			if (!channel.live) continue;
+
+			auto next = hints[c] = Core::seek(&frames_[channel.firstKey], channel.keys, hints[c], frame);
+			out[c] = values_[channel.firstKey + (next ? next - 1 : 0)];
+		}
+	}
+
+private:
+	struct Channel
+	{
+		size_t firstKey;
+		size_t keys;
+		bool live;
+	};
+
+	void compile(Channel& channel, const Property& property) noexcept
+	{
+		const Frame origin = 0;
+		auto& keys = property.keys();
+		auto frames = keys.empty() ? &origin : keys.data();
+		auto count = std::max<size_t>(keys.size(), 1);
+
+		channel.firstKey = frames_.size();
+		channel.keys = count;
+		frames_.insert(end(frames_), frames, frames + count);
+		values_.resize(frames_.size());
+		property.evaluate(frames, count, &values_[channel.firstKey]);
+	}
+
+	std::vector<Channel> channels_;
+	std::vector<Frame> frames_;
+	std::vector<std::string> values_;
+	size_t garbage_ {};
+};
+
+int read(const Evaluator::Result& result, size_t offset, int*) noexcept { return result.ints[offset]; }
+double read(const Evaluator::Result& result, size_t offset, double*) noexcept { return result.doubles[offset]; }
+glm::vec2 read(const Evaluator::Result& result, size_t offset, glm::vec2*) noexcept { return glm::vec2(result.floats[offset], result.floats[offset + 1]); }
+glm::vec3 read(const Evaluator::Result& result, size_t offset, glm::vec3*) noexcept { return glm::vec3(result.floats[offset], result.floats[offset + 1], result.floats[offset + 2]); }
+std::string read(const Evaluator::Result& result, size_t offset, std::string*) noexcept { return result.strings[offset]; }
+
+}
+
+struct Evaluator::Cursor::State
+{
+	Table<int>::Scratch ints;
+	Table<double>::Scratch doubles;
+	Table<float>::Scratch floats;
+	std::vector<size_t> strings;
+};
+
+struct Evaluator::Impl
+{
+	struct Entry
+	{
+		HashValue propertyType;
+		Slot slot;
+		size_t channel;
+	};
+
+	Table<int> ints;
+	Table<double> doubles;
+	Table<float> floats;
+	StringTable strings;
+	std::unordered_map<Uuid, std::vector<Entry>> nodes;
+
+	explicit Impl(const Document& document) noexcept
+	{
+		for (auto&& node : document.nodes())
+		{
+			for (auto&& property : node->properties()) add(node->uuid(), *property);
+		}
+	}
+
+	void add(const Uuid& node, const Property& property) noexcept
+	{
+		Entry entry { property.propertyType(), { static_cast<Type>(property.metadata().defaultValue().which()), 0 }, 0 };
+		switch (entry.slot.type)
+		{
+		case Type::Int:
+			entry.channel = ints.add<int>(property);
+			entry.slot.offset = ints.channel(entry.channel).lane;
+			break;
+		case Type::Double:
+			entry.channel = doubles.add<double>(property);
+			entry.slot.offset = doubles.channel(entry.channel).lane;
+			break;
+		case Type::Vec2:
+			entry.channel = floats.add<glm::vec2>(property);
+			entry.slot.offset = floats.channel(entry.channel).lane;
+			break;
+		case Type::Vec3:
+			entry.channel = floats.add<glm::vec3>(property);
+			entry.slot.offset = floats.channel(entry.channel).lane;
+			break;
+		case Type::String:
+			entry.channel = strings.add(property);
+			entry.slot.offset = entry.channel;
+			break;
+		}
+		nodes[node].emplace_back(entry);
+	}
+
+	void replace(const Uuid& node, const Property& property) noexcept
+	{
+		auto entry = find(node, property.propertyType());
+		assert(entry);
+		if (!entry) return;
+
+		switch (entry->slot.type)
+		{
+		case Type::Int: ints.replace<int>(entry->channel, property); break;
+		case Type::Double: doubles.replace<double>(entry->channel, property); break;
+		case Type::Vec2: floats.replace<glm::vec2>(entry->channel, property); break;
+		case Type::Vec3: floats.replace<glm::vec3>(entry->channel, property); break;
+		case Type::String: strings.replace(entry->channel, property); break;
+		}
+	}
+
+	void remove(const Uuid& node, const Property& property) noexcept
+	{
+		auto entry = find(node, property.propertyType());
+		assert(entry);
+		if (!entry) return;
+
+		switch (entry->slot.type)
+		{
+		case Type::Int: ints.remove(entry->channel); break;
+		case Type::Double: doubles.remove(entry->channel); break;
+		case Type::Vec2:
+		case Type::Vec3: floats.remove(entry->channel); break;
+		case Type::String: strings.remove(entry->channel); break;
+		}
+
+		auto& entries = nodes[node];
+		entries.erase(entries.begin() + (entry - entries.data()));
+		if (entries.empty()) nodes.erase(node);
+	}
+
+	Entry* find(const Uuid& node, HashValue propertyType) noexcept
+	{
+		auto it = nodes.find(node);
+		if (it == end(nodes)) return nullptr;
+
+		auto entry = find_if(begin(it->second), end(it->second), [&](auto& e) { return e.propertyType == propertyType; });
+		return entry == end(it->second) ? nullptr : &*entry;
+	}
+
+	bool wasteful() const noexcept
+	{
+		return ints.wasteful() || doubles.wasteful() || floats.wasteful() || strings.wasteful();
+	}
+};
+
+Evaluator::Cursor::Cursor()
+	: state_(std::make_unique<State>())
+{}
+
+Evaluator::Cursor::~Cursor() = default;
+Evaluator::Cursor::Cursor(Cursor&& rhs) noexcept = default;
+Evaluator::Cursor& Evaluator::Cursor::operator=(Cursor&& rhs) noexcept = default;
+
+template <typename T>
+T Evaluator::Result::get(const Slot& slot) const noexcept
+{
+	return read(*this, slot.offset, static_cast<T*>(nullptr));
+}
+
+template int Evaluator::Result::get<int>(const Slot& slot) const noexcept;
+template double Evaluator::Result::get<double>(const Slot& slot) const noexcept;
+template glm::vec2 Evaluator::Result::get<glm::vec2>(const Slot& slot) const noexcept;
+template glm::vec3 Evaluator::Result::get<glm::vec3>(const Slot& slot) const noexcept;
+template std::string Evaluator::Result::get<std::string>(const Slot& slot) const noexcept;
+
+Evaluator::Evaluator(const Document& document)
+	: impl_(std::make_unique<Impl>(document))
+{}
+
+Evaluator::~Evaluator() = default;
+
+void Evaluator::update(const MutationInfo& mutation) noexcept
+{
+	for (auto&& change : mutation.properties)
+	{
+		switch (change.type)
+		{
+		case MutationInfo::ChangeType::Added: impl_->add(change.curParent->uuid(), *change.cur); break;
+		case MutationInfo::ChangeType::Removed: impl_->remove(change.prevParent->uuid(), *change.prev); break;
+		case MutationInfo::ChangeType::Mutated: impl_->replace(change.curParent->uuid(), *change.cur); break;
+		}
+	}
+
+	// Once half of the tables is left over from older versions, starting over is cheaper than skipping it
+	if (impl_->wasteful()) impl_ = std::make_unique<Impl>(mutation.cur);
+}
+
+const Evaluator::Slot* Evaluator::slot(const Uuid& node, HashValue propertyType) const noexcept
+{
+	auto entry = impl_->find(node, propertyType);
+	return entry ? &entry->slot : nullptr;
+}
+
+void Evaluator::evaluate(Frame frame, Result& result) const noexcept
+{
+	Cursor cursor;
+	evaluate(frame, result, cursor);
+}
+
+void Evaluator::evaluate(Frame frame, Result& result, Cursor& cursor) const noexcept
+{
+	auto& state = *cursor.state_;
+	auto& impl = *impl_;
+
+	result.ints.resize(impl.ints.lanes());
+	result.doubles.resize(impl.doubles.lanes());
+	result.floats.resize(impl.floats.lanes());
+	result.strings.resize(impl.strings.slots());
+
+	impl.ints.evaluate(frame, result.ints.data(), state.ints);
+	impl.doubles.evaluate(frame, result.doubles.data(), state.doubles);
+	impl.floats.evaluate(frame, result.floats.data(), state.floats);
+	impl.strings.evaluate(frame, result.strings.data(), state.strings);
+}
+
+void Evaluator::evaluate(const FrameSet& frames, Result* results) const noexcept
+{
+	// Consecutive frames share a cursor, so a range still only walks the keys once per chunk
+	Core::parallelFor(frames.size(), PARALLEL_EVALUATE_GRAIN_SIZE, [&](size_t first, size_t last, size_t chunk)
+	{
+		Cursor cursor;
+		for (auto t = first; t < last; t++) evaluate(frames[t], results[t], cursor);
+	});
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "static.h"
+#include "document.h"
+#include "mutation_info.h"
+#include <cmath>
+
+BEGIN_NAMESPACE(Core)
+
+// Evaluates every property of a document at a frame. The keys are compiled into tables per type, with vec2 and vec3
+// split into float lanes, so evaluating looks up a segment per property and then interpolates all lanes of a type
+// in one loop over contiguous arrays. Values are the same to the bit as those of Property::getPropertyValue.
+class Evaluator
+{
+	struct Impl;
+
+public:
+	// In the same order as the types of PropertyValue
+	enum class Type { Int, Double, Vec2, Vec3, String };
+
+	// Where the value of a property is found in a Result
+	struct Slot
+	{
+		Type type;
+		size_t offset; // into the buffer for the type, a vec2 or vec3 takes up that many floats
+	};
+
+	struct Result
+	{
+		std::vector<int> ints;
+		std::vector<double> doubles;
+		std::vector<float> floats;
+		std::vector<std::string> strings;
+
+		template <typename T>
+		T get(const Slot& slot) const noexcept;
+	};
+
+	// The frames to evaluate at, either a list or count frames from start that are step apart.
+	// Frame t of the latter is start + t * step, as in Property::evaluate.
+	class FrameSet
+	{
+	public:
+		FrameSet(Frame start, Frame step, size_t count) noexcept: start_(start), step_(step), count_(count) {}
+		explicit FrameSet(std::vector<Frame> frames) noexcept: frames_(std::move(frames)), count_(frames_.size()) {}
+
+		// Every frame from first up to and including last, step has to be positive. Empty when there is no such frame,
+		// or when first, last or step isn't a finite number.
+		static FrameSet range(Frame first, Frame last, Frame step = 1) noexcept
+		{
+			assert(step > 0);
+			auto steps = (last - first) / step;
+			if (!(step > 0) || !(steps >= 0) || !std::isfinite(steps) || steps >= static_cast<Frame>(SIZE_MAX)) return FrameSet(first, step, 0);
+			return FrameSet(first, step, static_cast<size_t>(steps) + 1);
+		}
+
+		size_t size() const noexcept { return count_; }
+		Frame operator[](size_t index) const noexcept { return frames_.empty() ? start_ + static_cast<Frame>(index) * step_ : frames_[index]; }
+
+	private:
+		std::vector<Frame> frames_;
+		Frame start_ {};
+		Frame step_ {};
+		size_t count_;
+	};
+
+	// The segment every property was last evaluated in, evaluating increasing frames with the same cursor
+	// only walks the keys once. A cursor can only be used by one thread at a time.
+	class Cursor
+	{
+		struct State;
+
+	public:
+		Cursor();
+		~Cursor();
+
+		Cursor(Cursor&& rhs) noexcept;
+		Cursor& operator=(Cursor&& rhs) noexcept;
+
+	private:
+		friend class Evaluator;
+		std::unique_ptr<State> state_;
+	};
+
+	explicit Evaluator(const Document& document);
+	~Evaluator();
+
+	Evaluator(const Evaluator&) = delete;
+	Evaluator& operator=(const Evaluator&) = delete;
+
+	// Follows the document from mutation.prev to mutation.cur, only properties that changed are compiled again
+	void update(const MutationInfo& mutation) noexcept;
+
+	// Nullptr if the node doesn't exist or doesn't have the property. Slots are only valid until the next update.
+	const Slot* slot(const Uuid& node, HashValue propertyType) const noexcept;
+
+	// Safe to call from several threads at once, as long as each has its own result and cursor
+	void evaluate(Frame frame, Result& result) const noexcept;
+	void evaluate(Frame frame, Result& result, Cursor& cursor) const noexcept;
+
+	// Evaluates frame t of the set into results[t] on the worker pool, the results are the same as one at a time
+	void evaluate(const FrameSet& frames, Result* results) const noexcept;
+
+private:
+	std::unique_ptr<Impl> impl_;
+};
+
+END_NAMESPACE(Core)
@@ -0,0 +1,214 @@
+#pragma once
+#include "static.h"
+#include <bitset>
+
+BEGIN_NAMESPACE(Core)
+
+// Persistent hash array mapped trie.
+// Copies are O(1) and share all structure; set() and erase() only copy the path to the changed entry,
+// so every version of the map stays valid and unchanged versions cost no extra memory.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class HashTrie
+{
+	struct TrieNode;
+	using trie_node_ptr = std::shared_ptr<const TrieNode>;
+
+	struct Slot
+	{
+		trie_node_ptr child;
+		K key;
+		V value;
+	};
+
+	// Below maxShift the slots are indexed by bitmap, at maxShift the hash is exhausted and
+	// the node is a plain list of colliding entries
+	struct TrieNode
+	{
+		uint32_t bitmap {};
+		std::vector<Slot> slots;
+	};
+
+	static constexpr unsigned bitsPerLevel = 5;
+	static constexpr unsigned maxShift = sizeof(size_t) * 8;
+
+public:
+	size_t size() const noexcept { return size_; }
+	bool empty() const noexcept { return size_ == 0; }
+
+	const V* find(const K& key) const noexcept
+	{
+		auto hash = Hash()(key);
+		unsigned shift = 0;
+
+		for (auto node = root_.get(); node; shift += bitsPerLevel)
+		{
+			if (shift >= maxShift)
+			{
+				for (auto&& slot : node->slots) if (slot.key == key) return &slot.value;
+				return nullptr;
+			}
+
+			auto bit = bitFor(hash, shift);
+			if (!(node->bitmap & bit)) return nullptr;
+
+			auto& slot = node->slots[slotIndex(node->bitmap, bit)];
+			if (!slot.child) return slot.key == key ? &slot.value : nullptr;
+			node = slot.child.get();
+		}
+
+		return nullptr;
+	}
+
+	void set(const K& key, V value)
+	{
+		bool added = false;
+		root_ = set(root_.get(), 0, Hash()(key), key, std::move(value), added);
+		if (added) size_++;
+	}
+
+	void erase(const K& key)
+	{
+		bool removed = false;
+		auto root = erase(root_, 0, Hash()(key), key, removed);
+		if (!removed) return;
+		root_ = root;
+		size_--;
+	}
+
+	template <typename Fn>
+	void forEach(Fn fn) const
+	{
+		forEach(root_.get(), fn);
+	}
+
+	// Identity of the underlying structure, two maps with the same identity hold the same entries
+	const void* identity() const noexcept { return root_.get(); }
+
+private:
+	static uint32_t bitFor(size_t hash, unsigned shift) noexcept
+	{
+		return 1u << ((hash >> shift) & ((1u << bitsPerLevel) - 1));
+	}
+
+	static size_t slotIndex(uint32_t bitmap, uint32_t bit) noexcept
+	{
+		return std::bitset<32>(bitmap & (bit - 1)).count();
+	}
+
+	static trie_node_ptr set(const TrieNode* node, unsigned shift, size_t hash, const K& key, V&& value, bool& added)
+	{
+		auto result = node ? std::make_shared<TrieNode>(*node) : std::make_shared<TrieNode>();
+
+		if (shift >= maxShift)
+		{
+			for (auto&& slot : result->slots)
+			{
+				if (slot.key == key)
+				{
+					slot.value = std::move(value);
+					return result;
+				}
+			}
+			result->slots.emplace_back(Slot { nullptr, key, std::move(value) });
+			added = true;
+			return result;
+		}
+
+		auto bit = bitFor(hash, shift);
+		auto index = slotIndex(result->bitmap, bit);
+
+		if (!(result->bitmap & bit))
+		{
+			result->bitmap |= bit;
+			result->slots.insert(begin(result->slots) + index, Slot { nullptr, key, std::move(value) });
+			added = true;
+			return result;
+		}
+
+		auto& slot = result->slots[index];
+		if (slot.child)
+		{
+			slot.child = set(slot.child.get(), shift + bitsPerLevel, hash, key, std::move(value), added);
+		}
+		else if (slot.key == key)
+		{
+			slot.value = std::move(value);
+		}
+		else
+		{
+			// Two keys share this slot, push both of them one level down
+			bool ignored = false;
+			auto child = set(nullptr, shift + bitsPerLevel, Hash()(slot.key), slot.key, std::move(slot.value), ignored);
+			slot.child = set(child.get(), shift + bitsPerLevel, hash, key, std::move(value), added);
+			slot.key = K();
+			slot.value = V();
+		}
+
+		return result;
+	}
+
+	static trie_node_ptr erase(const trie_node_ptr& node, unsigned shift, size_t hash, const K& key, bool& removed)
+	{
+		if (!node) return node;
+
+		if (shift >= maxShift)
+		{
+			auto it = find_if(cbegin(node->slots), cend(node->slots), [&](auto& slot) { return slot.key == key; });
+			if (it == cend(node->slots)) return node;
+
+			removed = true;
+			if (node->slots.size() == 1) return nullptr;
+			auto result = std::make_shared<TrieNode>(*node);
+			result->slots.erase(begin(result->slots) + distance(cbegin(node->slots), it));
+			return result;
+		}
+
+		auto bit = bitFor(hash, shift);
+		if (!(node->bitmap & bit)) return node;
+
+		auto index = slotIndex(node->bitmap, bit);
+		auto& slot = node->slots[index];
+
+		trie_node_ptr child;
+		if (slot.child)
+		{
+			child = erase(slot.child, shift + bitsPerLevel, hash, key, removed);
+			if (!removed) return node;
+		}
+		else
+		{
+			if (!(slot.key == key)) return node;
+			removed = true;
+		}
+
+		if (!child && node->slots.size() == 1) return nullptr;
+
+		auto result = std::make_shared<TrieNode>(*node);
+		if (child)
+		{
+			result->slots[index].child = child;
+		}
+		else
+		{
+			result->bitmap &= ~bit;
+			result->slots.erase(begin(result->slots) + index);
+		}
+		return result;
+	}
+
+	template <typename Fn>
+	static void forEach(const TrieNode* node, Fn& fn)
+	{
+		if (!node) return;
+		for (auto&& slot : node->slots)
+		{
+			if (slot.child) forEach(slot.child.get(), fn);
+			else fn(slot.key, slot.value);
+		}
+	}
+
+	trie_node_ptr root_;
+	size_t size_ {};
+};
+
+END_NAMESPACE(Core)
@@ -0,0 +1,68 @@
+#pragma once
+#include "static.h"
+#include <algorithm>
+
+BEGIN_NAMESPACE(Core)
+
+// Catmull-Rom between two keys, the outer control points are those same keys in swapped order.
+// The coefficients only depend on the keys, so frames that fall in the same segment share them.
+template <typename T>
+struct Segment
+{
+	using coefficient_t = decltype(std::declval<T>() * 0.5f);
+
+	Segment() = default;
+	Segment(const T& p, const T& n) noexcept
+	{
+		const T& pp = n;
+		const T& nn = p;
+
+		a0 = (pp * -0.5f) + (p * 1.5f) - (n * 1.5f) + (nn * 0.5f);
+		a1 = pp - p * 2.5f + n * 2.0f - nn * 0.5f;
+		a2 = pp * -0.5f + n * 0.5f;
+		a3 = p;
+	}
+
+	T operator()(float alpha) const noexcept { return interpolate(a0, a1, a2, a3, alpha); }
+
+	// Everything that evaluates a segment goes through here, so all of them agree to the bit
+	static T interpolate(const coefficient_t& a0, const coefficient_t& a1, const coefficient_t& a2, const coefficient_t& a3, float alpha) noexcept
+	{
+		float alpha2 = alpha * alpha;
+		return static_cast<T>(a0 * alpha * alpha2 + a1 * alpha2 + a2 * alpha + a3);
+	}
+
+	coefficient_t a0, a1, a2, a3;
+};
+
+// Strings aren't interpolated, they hold until the next key
+template <>
+struct Segment<std::string>
+{
+	Segment() = default;
+	Segment(const std::string& p, const std::string& n) noexcept: p_(&p) {}
+	const std::string& operator()(float alpha) const noexcept { return *p_; }
+
+private:
+	const std::string* p_ {};
+};
+
+// Same as upper_bound over count sorted frames, but when frame isn't before the one at hint - 1 it gallops forward
+// from hint, so frames that come in increasing order only cost the keys they pass
+inline size_t seek(const Frame* frames, size_t count, size_t hint, Frame frame) noexcept
+{
+	hint = std::min(hint, count);
+	if (hint && frame < frames[hint - 1]) return static_cast<size_t>(std::upper_bound(frames, frames + hint, frame) - frames);
+
+	auto lower = hint;
+	auto upper = hint;
+	for (size_t step = 1; upper < count && frames[upper] <= frame; step *= 2)
+	{
+		lower = upper + 1;
+		upper = lower + step;
+	}
+	upper = std::min(upper, count);
+	return static_cast<size_t>(std::upper_bound(frames + lower, frames + upper, frame) - frames);
+}
+
+END_NAMESPACE(Core)
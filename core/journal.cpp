@@ -0,0 +1,261 @@
+#include "journal.h"
+#include "project.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using Core::Document;
+using Core::Journal;
+using Core::Project;
+
+namespace {
+
+const char MAGIC[4] = { 'P', 'S', 'J', '1' };
+const size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(uint64_t); // magic + checksum of the snapshot
+
+// FNV-1a, the files outlive the process so std::hash won't do
+uint64_t checksum(const char* data, size_t size) noexcept
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t t = 0; t < size; t++) hash = (hash ^ static_cast<unsigned char>(data[t])) * 1099511628211ull;
+	return hash;
+}
+
+// Size and checksum, followed by that many bytes
+std::string record(const std::string& payload)
+{
+	uint64_t header[2] = { payload.size(), checksum(payload.data(), payload.size()) };
+	std::string result(reinterpret_cast<const char*>(header), sizeof(header));
+	return result += payload;
+}
+
+// The payload of the record at offset, or false if it was cut off or damaged
+bool readRecord(const std::string& data, size_t& offset, std::string& payload)
+{
+	uint64_t header[2];
+	if (data.size() - offset < sizeof(header)) return false;
+	std::memcpy(header, data.data() + offset, sizeof(header));
+	if (header[0] > data.size() - offset - sizeof(header) || header[1] != checksum(data.data() + offset + sizeof(header), header[0])) return false;
+
+	payload = data.substr(offset + sizeof(header), header[0]);
+	offset += sizeof(header) + header[0];
+	return true;
+}
+
+std::string snapshotPath(const std::string& path) { return path + ".autosave"; }
+std::string journalPath(const std::string& path) { return path + ".journal"; }
+
+bool syncFile(std::FILE* file) noexcept
+{
+	if (std::fflush(file)) return false;
+#ifdef _WIN32
+	return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)))) != 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool replaceFile(const std::string& from, const std::string& to) noexcept
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// Nothing is replaced until the new contents are on disk
+bool writeFile(const std::string& path, const std::string& data) noexcept
+{
+	auto temp = path + ".tmp";
+	auto file = std::fopen(temp.c_str(), "wb");
+	if (!file) return false;
+
+	auto written = std::fwrite(data.data(), 1, data.size(), file) == data.size() && syncFile(file);
+	std::fclose(file);
+	return written && replaceFile(temp, path);
+}
+
+bool readFile(const std::string& path, std::string& data) noexcept
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream) return false;
+	data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	return true;
+}
+
+}
+
+Journal::Journal(std::string path) noexcept
+	: path_(std::move(path))
+{
+	thread_ = std::thread([this]() { run(); });
+}
+
+Journal::~Journal()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	thread_.join();
+
+	if (journal_) std::fclose(journal_);
+}
+
+void Journal::append(const Document::Delta& delta, bool inverse) noexcept
+{
+	std::ostringstream stream(std::ios::binary);
+	{
+		cereal::BinaryOutputArchive archive(stream);
+		archive(inverse);
+		archive(delta);
+	}
+
+	// Size and checksum first, so a record that was cut off by a crash is recognized as such
+	Job job;
+	job.record = record(stream.str());
+	journalSize_ += job.record.size();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.push_back(std::move(job));
+	}
+	wake_.notify_one();
+}
+
+void Journal::snapshot(NodePtr root, const Document& document) noexcept
+{
+	journalSize_ = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.push_back({ {}, root, document });
+	}
+	wake_.notify_one();
+}
+
+bool Journal::needsSnapshot() const noexcept
+{
+	return journalSize_ > std::max(snapshotSize_.load(), size_t(MIN_SNAPSHOT_INTERVAL));
+}
+
+void Journal::flush() noexcept
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_.wait(lock, [&]() { return jobs_.empty() && !busy_; });
+}
+
+void Journal::run() noexcept
+{
+	for (;;)
+	{
+		std::deque<Job> jobs;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [&]() { return stop_ || !jobs_.empty(); });
+			if (jobs_.empty()) return;
+
+			jobs.swap(jobs_);
+			busy_ = true;
+		}
+
+		// Records that come before the first snapshot have nothing to go on top of
+		for (auto&& job : jobs)
+		{
+			if (job.root) writeSnapshot(job);
+			else if (journal_) std::fwrite(job.record.data(), 1, job.record.size(), journal_);
+		}
+
+		// Caught up, one sync covers everything that came in while the previous one was going on
+		if (journal_) syncFile(journal_);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			busy_ = false;
+		}
+		idle_.notify_all();
+	}
+}
+
+void Journal::writeSnapshot(const Job& job) noexcept
+{
+	std::ostringstream stream(std::ios::binary);
+	{
+		// The same layout as Project::save, so restore can load it into a Project
+		cereal::BinaryOutputArchive archive(stream);
+		archive(job.root);
+		archive(job.document);
+	}
+	auto snapshot = stream.str();
+
+	// Without a new snapshot the old pair is still complete, keep adding to it
+	if (!writeFile(snapshotPath(path_), record(snapshot))) return;
+	snapshotSize_ = snapshot.size();
+
+	auto hash = checksum(snapshot.data(), snapshot.size());
+	std::string header(MAGIC, sizeof(MAGIC));
+	header.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+
+	if (journal_) std::fclose(journal_);
+	journal_ = writeFile(journalPath(path_), header) ? std::fopen(journalPath(path_).c_str(), "ab") : nullptr;
+}
+
+bool Journal::restore(const std::string& path, Project& project) noexcept
+{
+	std::string file, snapshot;
+	size_t offset = 0;
+	if (!readFile(snapshotPath(path), file) || !readRecord(file, offset, snapshot)) return false;
+
+	// A journal that belongs to an older snapshot only holds changes the snapshot already includes
+	std::string journal;
+	auto current = readFile(journalPath(path), journal) && journal.size() >= HEADER_SIZE && !std::memcmp(journal.data(), MAGIC, sizeof(MAGIC));
+	uint64_t hash {};
+	if (current) std::memcpy(&hash, journal.data() + sizeof(MAGIC), sizeof(hash));
+	current = current && hash == checksum(snapshot.data(), snapshot.size());
+
+	// Everything is read before the project is touched, so it is left alone when something doesn't load
+	std::vector<std::pair<bool, Document::Delta>> changes;
+	try
+	{
+		std::string payload;
+		for (offset = HEADER_SIZE; current && readRecord(journal, offset, payload);)
+		{
+			std::istringstream stream(payload, std::ios::binary);
+			cereal::BinaryInputArchive archive(stream);
+			changes.emplace_back();
+			archive(changes.back().first);
+			archive(changes.back().second);
+		}
+
+		std::istringstream stream(snapshot, std::ios::binary);
+		cereal::BinaryInputArchive archive(stream);
+		archive(project);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	for (auto&& change : changes) project.replay(change.second, change.first);
+	return true;
+}
+
+void Journal::remove(const std::string& path) noexcept
+{
+	for (auto&& file : { snapshotPath(path), journalPath(path) })
+	{
+		std::remove(file.c_str());
+		std::remove((file + ".tmp").c_str());
+	}
+}
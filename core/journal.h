@@ -0,0 +1,69 @@
+#pragma once
+#include "static.h"
+#include "document.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+BEGIN_NAMESPACE(Core)
+
+// Crash-safe autosave: a snapshot of a project at path + ".autosave" and the changes made since then at path + ".journal".
+// Appending only costs serializing the change, writing and syncing happens in order on a background thread.
+// The snapshot and every change are stored with their size and a checksum, so damaged files are recognized.
+// A new snapshot replaces both files, the journal remembers a hash of its snapshot so a crash halfway through
+// leaves either the old pair or a new snapshot whose journal is ignored.
+class Journal
+{
+public:
+	// Past this many bytes, replaying the journal takes longer than loading a new snapshot would
+	static const size_t MIN_SNAPSHOT_INTERVAL = 16 * 1024 * 1024;
+
+	explicit Journal(std::string path) noexcept;
+	~Journal();
+
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	void append(const Document::Delta& delta, bool inverse) noexcept;
+
+	// Starts over from the given document, this is when the files are compacted
+	void snapshot(NodePtr root, const Document& document) noexcept;
+	bool needsSnapshot() const noexcept;
+
+	// Blocks until everything appended so far is on disk
+	void flush() noexcept;
+
+	// Loads the snapshot into project and replays the journal after it, up to the first record that wasn't written completely.
+	// False, with the project left alone, if there is no snapshot or the files can't be read.
+	static bool restore(const std::string& path, Project& project) noexcept;
+	static void remove(const std::string& path) noexcept;
+
+private:
+	struct Job
+	{
+		std::string record;
+		NodePtr root; // set for a snapshot
+		Document document;
+	};
+
+	void run() noexcept;
+	void writeSnapshot(const Job& job) noexcept;
+	void sync() noexcept;
+
+	std::string path_;
+	size_t journalSize_ {}; // bytes appended since the last snapshot
+	std::atomic<size_t> snapshotSize_ { 0 };
+
+	std::FILE* journal_ {};
+	std::deque<Job> jobs_;
+	bool busy_ {};
+	bool stop_ {};
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable idle_;
+	std::thread thread_;
+};
+
+END_NAMESPACE(Core)
@@ -0,0 +1,196 @@
+#include "mapped_file.h"
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using Core::MappedFile;
+
+namespace {
+
+// Reads straight from memory, without copying the record first
+class MemoryBuffer: public std::streambuf
+{
+public:
+	MemoryBuffer(const char* data, size_t size)
+	{
+		auto begin = const_cast<char*>(data);
+		setg(begin, begin, begin + size);
+	}
+};
+
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() noexcept
+{
+	char dir[MAX_PATH], path[MAX_PATH];
+	if (!GetTempPathA(MAX_PATH, dir) || !GetTempFileNameA(dir, "psh", 0, path)) return;
+
+	auto file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (file != INVALID_HANDLE_VALUE) file_ = file;
+}
+
+MappedFile::~MappedFile()
+{
+	unmap();
+	if (file_) CloseHandle(file_);
+}
+
+MappedFile::Record MappedFile::append(const std::string& data) noexcept
+{
+	// A file can't grow while it is mapped
+	unmap();
+	if (!file_ || data.empty()) return {};
+
+	LARGE_INTEGER offset;
+	offset.QuadPart = static_cast<LONGLONG>(size_);
+	if (!SetFilePointerEx(file_, offset, nullptr, FILE_BEGIN)) return {};
+
+	for (size_t written = 0; written < data.size();)
+	{
+		DWORD chunk;
+		auto count = static_cast<DWORD>(std::min<size_t>(data.size() - written, 1 << 30));
+		if (!WriteFile(file_, data.data() + written, count, &chunk, nullptr)) return {};
+		written += chunk;
+	}
+
+	Record result { size_, data.size() };
+	size_ += data.size();
+	records_++;
+	return result;
+}
+
+void MappedFile::release(const Record& record) noexcept
+{
+	if (!record.size) return;
+	assert(records_);
+	if (--records_) return;
+
+	unmap();
+	LARGE_INTEGER offset {};
+	if (SetFilePointerEx(file_, offset, nullptr, FILE_BEGIN)) SetEndOfFile(file_);
+	size_ = 0;
+}
+
+bool MappedFile::map() noexcept
+{
+	unmap();
+	if (!file_ || !size_) return false;
+
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_) return false;
+
+	view_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (!view_)
+	{
+		unmap();
+		return false;
+	}
+	viewSize_ = size_;
+	return true;
+}
+
+void MappedFile::unmap() noexcept
+{
+	if (view_) UnmapViewOfFile(view_);
+	if (mapping_) CloseHandle(mapping_);
+	view_ = nullptr;
+	mapping_ = nullptr;
+	viewSize_ = 0;
+}
+
+#else
+
+MappedFile::MappedFile() noexcept
+{
+	auto dir = std::getenv("TMPDIR");
+	auto path = std::string(dir && *dir ? dir : "/tmp") + "/pixelsynth-XXXXXX";
+
+	// Unlinked right away, the file lives on until it is closed
+	file_ = mkstemp(&path[0]);
+	if (file_ != -1) unlink(path.c_str());
+}
+
+MappedFile::~MappedFile()
+{
+	unmap();
+	if (file_ != -1) close(file_);
+}
+
+MappedFile::Record MappedFile::append(const std::string& data) noexcept
+{
+	if (file_ == -1 || data.empty()) return {};
+
+	for (size_t written = 0; written < data.size();)
+	{
+		auto chunk = pwrite(file_, data.data() + written, data.size() - written, static_cast<off_t>(size_ + written));
+		if (chunk <= 0) return {};
+		written += static_cast<size_t>(chunk);
+	}
+
+	Record result { size_, data.size() };
+	size_ += data.size();
+	records_++;
+	return result;
+}
+
+void MappedFile::release(const Record& record) noexcept
+{
+	if (!record.size) return;
+	assert(records_);
+	if (--records_) return;
+
+	unmap();
+	if (ftruncate(file_, 0) == 0) size_ = 0;
+}
+
+bool MappedFile::map() noexcept
+{
+	unmap();
+	if (file_ == -1 || !size_) return false;
+
+	auto view = mmap(nullptr, size_, PROT_READ, MAP_SHARED, file_, 0);
+	if (view == MAP_FAILED) return false;
+
+	view_ = static_cast<const char*>(view);
+	viewSize_ = size_;
+	return true;
+}
+
+void MappedFile::unmap() noexcept
+{
+	if (view_) munmap(const_cast<char*>(view_), viewSize_);
+	view_ = nullptr;
+	viewSize_ = 0;
+}
+
+#endif
+
+bool MappedFile::read(const Record& record, read_fn fn) noexcept
+{
+	assert(record.size);
+
+	// Records appended since the file was last mapped aren't in the view yet
+	if (record.offset + record.size > viewSize_ && !map()) return false;
+
+	MemoryBuffer buffer(view_ + record.offset, record.size);
+	std::istream stream(&buffer);
+	try
+	{
+		fn(stream);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+	return true;
+}
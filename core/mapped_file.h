@@ -0,0 +1,51 @@
+#pragma once
+#include "static.h"
+
+BEGIN_NAMESPACE(Core)
+
+// Scratch file for data that is rarely read back, it is deleted when the MappedFile is destroyed.
+// Records are appended once and read through a memory mapping of the file, so reading one back only
+// costs the pages it spans. The file is emptied once every record has been released.
+class MappedFile
+{
+public:
+	struct Record
+	{
+		size_t offset {};
+		size_t size {}; // 0 when the record couldn't be written
+	};
+
+	using read_fn = std::function<void(std::istream&)>;
+
+	MappedFile() noexcept;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	Record append(const std::string& data) noexcept;
+
+	// False if the file couldn't be mapped, or fn threw while reading the record
+	bool read(const Record& record, read_fn fn) noexcept;
+	void release(const Record& record) noexcept;
+
+	// Bytes in the file, including released records that are waiting for the rest to be released
+	size_t size() const noexcept { return size_; }
+
+private:
+	bool map() noexcept;
+	void unmap() noexcept;
+
+#ifdef _WIN32
+	void* file_ {};
+	void* mapping_ {};
+#else
+	int file_ { -1 };
+#endif
+	const char* view_ {};
+	size_t viewSize_ {};
+	size_t size_ {};
+	size_t records_ {};
+};
+
+END_NAMESPACE(Core)
@@ -144,6 +144,9 @@ struct connector_metadata_eq_hash
 	explicit connector_metadata_eq_hash(Core::ConnectorMetadataPtr ptr): ptr_(ptr) { }
 	bool operator()(Core::ConnectorMetadataPtr c1) const { return c1->hash() == ptr_->hash(); }
 
+	// Equal for every connector this matches
+	Core::HashValue key() const { return ptr_->hash(); }
+
 private:
 	Core::ConnectorMetadataPtr ptr_;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "mutation_info.h"
 #include "document.h"
+#include "parallel.h"
+#include <mutex>
 
 using Core::ConnectionPtr;
 using Core::ConnectorMetadataCollection;
@@ -8,8 +10,13 @@ using Core::Document;
 using Core::MutationInfo;
 using Core::Node;
 using Core::NodePtr;
+using Core::Property;
 using Core::PropertyPtr;
-using Core::node_eq_uuid;
+using Core::property_eq_hash;
+using Core::NodeTree;
+using Core::parallelChunks;
+using Core::parallelFor;
+using Core::Uuid;
 
 using ChangeType = MutationInfo::ChangeType;
 template <typename T>
@@ -17,115 +24,379 @@ using Change = MutationInfo::Change<T>;
 template <typename T>
 using ChangeSet = MutationInfo::ChangeSet<T>;
 
-template <typename Container>
-NodePtr findNodeByUuid(const Container& c, const Core::Uuid& uuid)
+using Branch = NodeTree::Branch;
+using BranchPtr = NodeTree::BranchPtr;
+
+// Nodes that were added, removed or got a new pointer, paired with their counterpart in the other document.
+// Only these nodes can have changed properties or connectors.
+using node_pairs_t = std::vector<std::pair<NodePtr, NodePtr>>;
+
+// Hint that nothing in the subtree changed, not even the order of the children. Comparing the subtrees node by node
+// would visit all of both documents, so past the root node a hash collision is taken for an unchanged subtree.
+bool sameSubtree(const Branch& lhs, const BranchPtr& rhs) noexcept
 {
-	auto it = find_if(cbegin(c), cend(c), [&](auto& node) { return node->uuid() == uuid; });
-	if (it != cend(c)) return *it;
-	return nullptr;
+	if (!rhs) return false;
+	if (&lhs == rhs.get()) return true;
+	return lhs.hash == rhs->hash && lhs.node == rhs->node && lhs.size == rhs->size && lhs.children.size() == rhs->children.size();
 }
 
-void findRemovedNodes(const MutationInfo& i, std::vector<Change<NodePtr>>& changes)
+// Child indices in one of the documents, only numbered for parents whose children actually moved
+class ChildIndices
 {
-	for (auto&& prevNode: i.prevNodes)
+public:
+	explicit ChildIndices(const NodeTree& tree): tree_(tree) {}
+
+	size_t operator()(const Branch* parent, const Uuid& uuid, size_t hint = -1)
 	{
-		auto curNode = findNodeByUuid(i.curNodes, prevNode->uuid());
-		if (curNode) continue;
-		changes.emplace_back(Change<NodePtr>(prevNode, {}, ChangeType::Removed, i.prev.parent(*prevNode), {}, i.prev.childIndex(*prevNode), -1));
+		// Most children stay where they were
+		auto& siblings = parent->children;
+		if (hint < siblings.size() && siblings[hint]->node->uuid() == uuid) return hint;
+
+		auto& indices = indices_[parent];
+		if (indices.empty())
+		{
+			size_t index = 0;
+			for (auto&& sibling : siblings) indices[sibling->node->uuid()] = index++;
+		}
+		return indices[uuid];
+	}
+
+	const NodeTree& tree_;
+	std::unordered_map<const Branch*, std::unordered_map<Uuid, size_t>> indices_;
+};
+
+void findRemovedNodes(const NodeTree& cur, const Branch& prevParent, std::vector<Change<NodePtr>>& changes, node_pairs_t& changed)
+{
+	for (size_t index = 0; index < prevParent.children.size(); index++)
+	{
+		auto& prevChild = *prevParent.children[index];
+		auto& prevNode = prevChild.node;
+
+		auto curChild = cur.branch(prevNode->uuid());
+		if (!curChild)
+		{
+			changes.emplace_back(Change<NodePtr>(prevNode, {}, ChangeType::Removed, prevParent.node, {}, index, -1));
+			changed.emplace_back(prevNode, nullptr);
+		}
+		else
+		{
+			if (curChild->node != prevNode) changed.emplace_back(prevNode, curChild->node);
+			if (sameSubtree(prevChild, curChild)) continue; // nothing below was removed
+		}
+
+		findRemovedNodes(cur, prevChild, changes, changed);
 	}
 }
 
-void findAddedOrMutatedNodes(const MutationInfo& i, std::vector<Change<NodePtr>>& changes)
+void findAddedOrMutatedNodes(ChildIndices& prevIndices, const Branch& curParent, std::vector<Change<NodePtr>>& changes, node_pairs_t& changed)
 {
-	for (auto&& curNode : i.curNodes)
+	auto& prev = prevIndices.tree_;
+
+	for (size_t index = 0; index < curParent.children.size(); index++)
 	{
-		auto prevNode = findNodeByUuid(i.prevNodes, curNode->uuid());
-		if (!prevNode)
+		auto& curChild = *curParent.children[index];
+		auto& curNode = curChild.node;
+
+		auto prevChild = prev.branch(curNode->uuid());
+		if (!prevChild)
 		{
 			// added
-			changes.emplace_back(Change<NodePtr>({}, curNode, ChangeType::Added, {}, i.cur.parent(*curNode), -1, i.cur.childIndex(*curNode)));
+			changes.emplace_back(Change<NodePtr>({}, curNode, ChangeType::Added, {}, curParent.node, -1, index));
+			changed.emplace_back(curNode, nullptr);
 		}
 		else
 		{
-			if (prevNode != curNode || i.prev.parent(*prevNode) != i.cur.parent(*curNode) || i.prev.childIndex(*prevNode) != i.cur.childIndex(*curNode))
+			auto prevParent = prev.parent(curNode->uuid());
+			auto prevIndex = prevIndices(prev.branch(prevParent->uuid()).get(), curNode->uuid(), index);
+			if (prevChild->node != curNode || prevParent != curParent.node || prevIndex != index)
 			{
 				// mutated
-				changes.emplace_back(Change<NodePtr>(prevNode, curNode, ChangeType::Mutated, i.prev.parent(*prevNode), i.cur.parent(*curNode), i.prev.childIndex(*prevNode), i.cur.childIndex(*curNode)));
+				changes.emplace_back(Change<NodePtr>(prevChild->node, curNode, ChangeType::Mutated, prevParent, curParent.node, prevIndex, index));
 			}
+
+			if (prevChild->node != curNode) changed.emplace_back(curNode, prevChild->node);
+			if (sameSubtree(curChild, prevChild)) continue; // nothing below was added or mutated
+		}
+
+		findAddedOrMutatedNodes(prevIndices, curChild, changes, changed);
+	}
+}
+
+// Preorder position of a node, as the child indices on the path from the root
+class PreorderKeys
+{
+public:
+	explicit PreorderKeys(const NodeTree& tree): indices_(tree) {}
+
+	const std::vector<size_t>& operator()(const Uuid& uuid)
+	{
+		auto it = keys_.find(uuid);
+		if (it != cend(keys_)) return it->second;
+
+		std::vector<size_t> key;
+		auto parent = indices_.tree_.parent(uuid);
+		if (parent)
+		{
+			key = (*this)(parent->uuid());
+			key.push_back(indices_(indices_.tree_.branch(parent->uuid()).get(), uuid));
+		}
+		return keys_.emplace(uuid, std::move(key)).first->second;
+	}
+
+	ChildIndices indices_;
+
+private:
+	std::unordered_map<Uuid, std::vector<size_t>> keys_;
+};
+
+template <typename T>
+void sortByKey(std::vector<std::pair<std::vector<size_t>, T>>& keyed, std::vector<T>& result)
+{
+	std::sort(begin(keyed), end(keyed), [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+	for (auto&& kvp : keyed) result.emplace_back(std::move(kvp.second));
+}
+
+// Only visits the children of the given parents, the given mutated nodes, and whatever was added or removed below them
+void findNodesFromOperations(const MutationInfo& i, const std::unordered_set<Uuid>& parents, const std::unordered_set<Uuid>& mutated, ChangeSet<NodePtr>& changes, node_pairs_t& prevChanged, node_pairs_t& curChanged)
+{
+	auto& prev = i.prev.nodes();
+	auto& cur = i.cur.nodes();
+
+	auto candidates = [&](const NodeTree& tree)
+	{
+		std::vector<Uuid> result;
+		for (auto&& uuid : parents)
+		{
+			auto branch = tree.branch(uuid);
+			if (branch) for (auto&& child : branch->children) result.emplace_back(child->node->uuid());
+		}
+		for (auto&& uuid : mutated)
+		{
+			auto branch = tree.branch(uuid);
+			if (!branch) continue;
+			if (branch != tree.rootBranch()) result.emplace_back(uuid);
+			for (auto&& child : branch->children) result.emplace_back(child->node->uuid());
 		}
+		return result;
+	};
+
+	PreorderKeys prevKeys(prev);
+	std::vector<std::pair<std::vector<size_t>, Change<NodePtr>>> removed;
+	std::vector<std::pair<std::vector<size_t>, std::pair<NodePtr, NodePtr>>> prevPairs;
+	std::unordered_set<Uuid> visited;
+	auto pending = candidates(prev);
+	while (!pending.empty())
+	{
+		auto uuid = pending.back();
+		pending.pop_back();
+		if (!visited.emplace(uuid).second) continue;
+
+		auto prevNode = prev.find(uuid);
+		auto curNode = cur.find(uuid);
+		if (curNode)
+		{
+			if (curNode != prevNode) prevPairs.emplace_back(prevKeys(uuid), std::make_pair(prevNode, curNode));
+			continue;
+		}
+
+		auto& key = prevKeys(uuid);
+		auto prevParent = prev.parent(uuid);
+		removed.emplace_back(key, Change<NodePtr>(prevNode, {}, ChangeType::Removed, prevParent, {}, key.back(), -1));
+		prevPairs.emplace_back(key, std::make_pair(prevNode, nullptr));
+		for (auto&& child : prev.branch(uuid)->children) pending.emplace_back(child->node->uuid());
+	}
+
+	PreorderKeys curKeys(cur);
+	std::vector<std::pair<std::vector<size_t>, Change<NodePtr>>> addedOrMutated;
+	std::vector<std::pair<std::vector<size_t>, std::pair<NodePtr, NodePtr>>> curPairs;
+	visited.clear();
+	pending = candidates(cur);
+	while (!pending.empty())
+	{
+		auto uuid = pending.back();
+		pending.pop_back();
+		if (!visited.emplace(uuid).second) continue;
+
+		auto curNode = cur.find(uuid);
+		auto prevNode = prev.find(uuid);
+		auto& key = curKeys(uuid);
+		auto curParent = cur.parent(uuid);
+		auto curIndex = key.back();
+
+		if (!prevNode)
+		{
+			// added
+			addedOrMutated.emplace_back(key, Change<NodePtr>({}, curNode, ChangeType::Added, {}, curParent, -1, curIndex));
+			curPairs.emplace_back(key, std::make_pair(curNode, nullptr));
+			for (auto&& child : cur.branch(uuid)->children) pending.emplace_back(child->node->uuid());
+			continue;
+		}
+
+		auto prevParent = prev.parent(uuid);
+		auto prevIndex = prevKeys.indices_(prev.branch(prevParent->uuid()).get(), uuid, curIndex);
+		if (prevNode != curNode || prevParent != curParent || prevIndex != curIndex)
+		{
+			// mutated
+			addedOrMutated.emplace_back(key, Change<NodePtr>(prevNode, curNode, ChangeType::Mutated, prevParent, curParent, prevIndex, curIndex));
+		}
+		if (prevNode != curNode) curPairs.emplace_back(key, std::make_pair(curNode, prevNode));
 	}
+
+	sortByKey(removed, changes);
+	sortByKey(addedOrMutated, changes);
+	sortByKey(prevPairs, prevChanged);
+	sortByKey(curPairs, curChanged);
 }
 
-void findRemovedConnections(const MutationInfo& i, std::vector<Change<ConnectionPtr>>& changes)
+void findRemovedConnections(const MutationInfo& i, const std::unordered_set<ConnectionPtr>& curConnections, std::vector<Change<ConnectionPtr>>& changes)
 {
 	for (auto&& prevConn : i.prev.connections())
 	{
-		auto curConnIt = find(cbegin(i.cur.connections()), cend(i.cur.connections()), prevConn);
-		if (curConnIt != cend(i.cur.connections())) continue;
+		if (curConnections.count(prevConn)) continue;
 		changes.emplace_back(Change<ConnectionPtr>(prevConn, {}, ChangeType::Removed, {}, {}, -1, -1));
 	}
 }
 
-void findAddedOrMutatedConnections(const MutationInfo& i, std::vector<Change<ConnectionPtr>>& changes)
+void findAddedOrMutatedConnections(const MutationInfo& i, const std::unordered_set<ConnectionPtr>& prevConnections, std::vector<Change<ConnectionPtr>>& changes)
 {
 	for (auto&& curConn : i.cur.connections())
 	{
-		auto prevConnIt = find(cbegin(i.prev.connections()), cend(i.prev.connections()), curConn);
-		if (prevConnIt != cend(i.prev.connections())) continue;
+		if (prevConnections.count(curConn)) continue;
 		changes.emplace_back(Change<ConnectionPtr>({}, curConn, ChangeType::Added, {}, {}, -1, -1));
 	}
 }
 
+// Above this many changed nodes, their items are diffed on the worker pool
+const size_t PARALLEL_DIFF_THRESHOLD = 2048;
+const size_t PARALLEL_DIFF_GRAIN_SIZE = 256;
+
+// Runs fn(pair, changes) for every pair. Every chunk of pairs collects its own changes, which are appended in
+// chunk order afterwards, so the result is the same as when the pairs are visited one after the other.
+template <typename ITEMPTR, typename Fn>
+void forEachPair(const node_pairs_t& pairs, std::vector<Change<ITEMPTR>>& changes, Fn fn)
+{
+	if (pairs.size() < PARALLEL_DIFF_THRESHOLD)
+	{
+		for (auto&& pair : pairs) fn(pair, changes);
+		return;
+	}
+
+	std::vector<std::vector<Change<ITEMPTR>>> chunks(parallelChunks(pairs.size(), PARALLEL_DIFF_GRAIN_SIZE));
+	parallelFor(pairs.size(), PARALLEL_DIFF_GRAIN_SIZE, [&](size_t first, size_t last, size_t chunk)
+	{
+		for (auto t = first; t < last; t++) fn(pairs[t], chunks[chunk]);
+	});
+
+	for (auto&& chunk : chunks) changes.insert(end(changes), std::make_move_iterator(begin(chunk)), std::make_move_iterator(end(chunk)));
+}
+
+// Up to this many items of a node are searched one after the other instead of through a map
+const size_t MAX_LINEAR_ITEMS = 16;
+
+// Finds the first item of a node that EqFn matches. The items are hashed by EqFn::key once, so diffing two nodes
+// is linear in their items; a key shared by items that don't match falls back to the search.
+template <typename ITEMPTR, typename EqFn>
+class ItemIndex
+{
+public:
+	explicit ItemIndex(const std::vector<ITEMPTR>* items): items_(items)
+	{
+		if (!items_ || items_->size() <= MAX_LINEAR_ITEMS) return;
+
+		indices_.reserve(items_->size());
+		for (size_t t = 0; t < items_->size(); t++) indices_.emplace(EqFn((*items_)[t]).key(), t);
+	}
+
+	// Position of the match in the items, -1 when there is none
+	size_t find(const ITEMPTR& item) const
+	{
+		if (!items_) return -1;
+
+		EqFn eq(item);
+		if (!indices_.empty())
+		{
+			auto it = indices_.find(eq.key());
+			if (it == cend(indices_)) return -1;
+			if (eq((*items_)[it->second])) return it->second;
+		}
+
+		auto itemIt = find_if(cbegin(*items_), cend(*items_), eq);
+		return itemIt == cend(*items_) ? -1 : std::distance(cbegin(*items_), itemIt);
+	}
+
+private:
+	const std::vector<ITEMPTR>* items_;
+	std::unordered_map<Core::HashValue, size_t> indices_;
+};
+
+// The index of an item is its position in the items of its node, the owner index of the document
+// would have to be built for every new version to look it up
 template <typename ITEMPTR, typename EqFn, typename GetItemsFn>
-void findRemovedItems(const MutationInfo& i, std::vector<Change<ITEMPTR>>& changes, GetItemsFn getItems)
+void findRemovedItems(const node_pairs_t& prevChanged, std::vector<Change<ITEMPTR>>& changes, GetItemsFn getItems)
 {
-	for (auto&& prevNode : i.prevNodes)
+	forEachPair(prevChanged, changes, [&](auto& pair, auto& changes)
 	{
-		auto curNode = findNodeByUuid(i.curNodes, prevNode->uuid());
-		for (auto&& prevItem : getItems(prevNode))
+		auto& prevNode = pair.first;
+		auto& curNode = pair.second;
+
+		auto& prevNodeItems = getItems(prevNode);
+		ItemIndex<ITEMPTR, EqFn> curItems(curNode ? &getItems(curNode) : nullptr);
+		for (size_t prevIndex = 0; prevIndex < prevNodeItems.size(); prevIndex++)
 		{
+			auto& prevItem = prevNodeItems[prevIndex];
 			bool removed = false;
 
 			if (curNode)
 			{
-				auto curNodeItems = getItems(curNode);
-				auto itemIt = find_if(cbegin(curNodeItems), cend(curNodeItems), [&](auto& item)
-				{
-					return EqFn(prevItem)(item);
-				});
-				removed = itemIt == cend(curNodeItems);
+				removed = curItems.find(prevItem) == size_t(-1);
 			}
 			else
 			{
 				removed = true;
 			}
 
-			if (removed) changes.emplace_back(Change<ITEMPTR>(prevItem, {}, ChangeType::Removed, prevNode, {}, i.prev.childIndex(*prevItem), -1));
+			if (removed) changes.emplace_back(Change<ITEMPTR>(prevItem, {}, ChangeType::Removed, prevNode, {}, prevIndex, -1));
 		}
-	}
+	});
+}
+
+// Consumers of mutated properties can patch the keys that changed instead of reloading all of them
+void describeMutation(Change<PropertyPtr>& change)
+{
+	change.keys = std::make_shared<const Property::KeyChanges>(Property::diffKeys(*change.prev, *change.cur));
 }
 
+template <typename T>
+void describeMutation(Change<T>&) {}
+
 template <typename ITEMPTR, typename EqFn, typename GetItemsFn>
-void findAddedOrMutatedItems(const MutationInfo& i, std::vector<Change<ITEMPTR>>& changes, GetItemsFn getItems)
+void findAddedOrMutatedItems(const node_pairs_t& curChanged, std::vector<Change<ITEMPTR>>& changes, GetItemsFn getItems)
 {
-	for (auto&& curNode : i.curNodes)
+	forEachPair(curChanged, changes, [&](auto& pair, auto& changes)
 	{
-		auto prevNode = findNodeByUuid(i.prevNodes, curNode->uuid());
-		for (auto&& curItem : getItems(curNode))
+		auto& curNode = pair.first;
+		auto& prevNode = pair.second;
+
+		auto& curNodeItems = getItems(curNode);
+		ItemIndex<ITEMPTR, EqFn> prevItems(prevNode ? &getItems(prevNode) : nullptr);
+		for (size_t curIndex = 0; curIndex < curNodeItems.size(); curIndex++)
 		{
+			auto& curItem = curNodeItems[curIndex];
 			bool added = false;
 			ITEMPTR prevItem {};
+			size_t prevIndex = -1;
 
 			if (prevNode)
 			{
-				auto prevNodeItems = getItems(prevNode);
-				auto itemIt = find_if(cbegin(prevNodeItems), cend(prevNodeItems), [&](auto& item)
+				prevIndex = prevItems.find(curItem);
+				if (prevIndex == size_t(-1))
 				{
-					return EqFn(curItem)(item);
-				});
-
-				if (itemIt == cend(prevNodeItems)) added = true;
-				else prevItem = *itemIt;
+					added = true;
+				}
+				else
+				{
+					prevItem = getItems(prevNode)[prevIndex];
+				}
 			}
 			else
 			{
@@ -135,38 +406,151 @@ void findAddedOrMutatedItems(const MutationInfo& i, std::vector<Change<ITEMPTR>>
 			if (added)
 			{
 				// added
-				changes.emplace_back(Change<ITEMPTR>({}, curItem, ChangeType::Added, {}, curNode, -1, i.cur.childIndex(*curItem)));
+				changes.emplace_back(Change<ITEMPTR>({}, curItem, ChangeType::Added, {}, curNode, -1, curIndex));
 			}
 			else
 			{
 				if (prevItem != curItem)
 				{
 					// mutated
-					changes.emplace_back(Change<ITEMPTR>(prevItem, curItem, ChangeType::Mutated, prevNode, curNode, i.prev.childIndex(*prevItem), i.cur.childIndex(*curItem)));
+					changes.emplace_back(Change<ITEMPTR>(prevItem, curItem, ChangeType::Mutated, prevNode, curNode, prevIndex, curIndex));
+					describeMutation(changes.back());
 				}
 			}
 		}
-	}
+	});
 }
 
+struct MutationInfo::Impl
+{
+	Impl(const Document& prev, const Document& cur): prev(prev), cur(cur) {}
+
+	Document prev;
+	Document cur;
+	Category categories { Category::None };
+
+	// Parents and mutated nodes named in the operations, when there were any
+	bool fromOperations {};
+	std::unordered_set<Uuid> parents, mutated;
+
+	std::once_flag nodesComputed, propertiesComputed, connectorsComputed, connectionsComputed;
+	node_pairs_t prevChanged, curChanged;
+};
+
 MutationInfo::MutationInfo(const Document& prev, const Document& cur)
-	: prev(prev)
-	, cur(cur)
+	: impl_(std::make_unique<Impl>(prev, cur))
+	, prev(impl_->prev)
+	, cur(impl_->cur)
 {
-	for (auto&& node : prev.nodes()) if (node != prev.root()) prevNodes.emplace_back(node);
-	for (auto&& node : cur.nodes()) if (node != cur.root()) curNodes.emplace_back(node);
+	// Every changed property or connector gives its node a new pointer, which changes the hash
+	if (prev.nodes().hash() != cur.nodes().hash() || prev.nodes().size() != cur.nodes().size())
+	{
+		impl_->categories = Category::Nodes | Category::Properties | Category::Connectors;
+	}
+	if (&prev.connections() != &cur.connections()) impl_->categories = impl_->categories | Category::Connections;
+	if (prev.settings().visibility != cur.settings().visibility) impl_->categories = impl_->categories | Category::Settings;
+}
 
-	findRemovedNodes(*this, nodes);
-	findAddedOrMutatedNodes(*this, nodes);
+MutationInfo::MutationInfo(const Document& prev, const Document& cur, const Document::operations_t& operations)
+	: impl_(std::make_unique<Impl>(prev, cur))
+	, prev(impl_->prev)
+	, cur(impl_->cur)
+{
+	// Every node whose pointer, parent or index changed is a mutated node or a child of a parent named
+	// in the log. That holds in both directions, so the same log describes undoing and redoing it.
+	auto& i = *impl_;
+	i.fromOperations = true;
+	for (auto&& op : operations)
+	{
+		switch (op.type)
+		{
+		case Document::Operation::Type::Insert:
+		case Document::Operation::Type::Erase:
+			if (!op.from.isEmpty()) i.parents.emplace(op.from);
+			if (!op.to.isEmpty()) i.parents.emplace(op.to);
+			i.categories = i.categories | Category::Nodes | Category::Properties | Category::Connectors;
+			break;
+		case Document::Operation::Type::Move:
+			if (!op.from.isEmpty()) i.parents.emplace(op.from);
+			if (!op.to.isEmpty()) i.parents.emplace(op.to);
+			i.categories = i.categories | Category::Nodes;
+			break;
+		case Document::Operation::Type::Mutate:
+			i.mutated.emplace(op.node);
+			i.categories = i.categories | Category::Nodes | Category::Properties | Category::Connectors;
+			break;
+		case Document::Operation::Type::Connect:
+		case Document::Operation::Type::Disconnect:
+			i.categories = i.categories | Category::Connections;
+			break;
+		case Document::Operation::Type::Settings:
+			i.categories = i.categories | Category::Settings;
+			break;
+		}
+	}
+}
+
+MutationInfo::~MutationInfo() = default;
+
+MutationInfo::Category MutationInfo::categories() const noexcept
+{
+	return impl_->categories;
+}
+
+void MutationInfo::compute(Category category) const
+{
+	auto& i = *impl_;
+	switch (category)
+	{
+	case Category::Nodes:
+		std::call_once(i.nodesComputed, [&]()
+		{
+			if (!touches(Category::Nodes)) return;
+
+			if (i.fromOperations)
+			{
+				findNodesFromOperations(*this, i.parents, i.mutated, nodes.changes_, i.prevChanged, i.curChanged);
+				return;
+			}
 
-	auto getProperties = [&](const NodePtr& n) { return n->properties(); };
-	findRemovedItems<PropertyPtr, property_eq_hash>(*this, properties, getProperties);
-	findAddedOrMutatedItems<PropertyPtr, property_eq_hash>(*this, properties, getProperties);
+			// Identical subtrees are skipped, so this only visits the parts of the documents that changed
+			findRemovedNodes(cur.nodes(), *prev.nodes().rootBranch(), nodes.changes_, i.prevChanged);
 
-	auto getConnectors = [&](const NodePtr& n) { return n->connectorMetadata(); };
-	findRemovedItems<ConnectorMetadataPtr, connector_metadata_eq_hash>(*this, connectors, getConnectors);
-	findAddedOrMutatedItems<ConnectorMetadataPtr, connector_metadata_eq_hash>(*this, connectors, getConnectors);
+			ChildIndices prevIndices(prev.nodes());
+			findAddedOrMutatedNodes(prevIndices, *cur.nodes().rootBranch(), nodes.changes_, i.curChanged);
+		});
+		break;
+	case Category::Properties:
+		compute(Category::Nodes);
+		std::call_once(i.propertiesComputed, [&]()
+		{
+			auto getProperties = [&](const NodePtr& n) -> auto& { return n->properties(); };
+			findRemovedItems<PropertyPtr, property_eq_hash>(i.prevChanged, properties.changes_, getProperties);
+			findAddedOrMutatedItems<PropertyPtr, property_eq_hash>(i.curChanged, properties.changes_, getProperties);
+		});
+		break;
+	case Category::Connectors:
+		compute(Category::Nodes);
+		std::call_once(i.connectorsComputed, [&]()
+		{
+			auto getConnectors = [&](const NodePtr& n) -> auto& { return n->connectorMetadata(); };
+			findRemovedItems<ConnectorMetadataPtr, connector_metadata_eq_hash>(i.prevChanged, connectors.changes_, getConnectors);
+			findAddedOrMutatedItems<ConnectorMetadataPtr, connector_metadata_eq_hash>(i.curChanged, connectors.changes_, getConnectors);
+		});
+		break;
+	case Category::Connections:
+		std::call_once(i.connectionsComputed, [&]()
+		{
+			// Documents that weren't changed through the Builder share their connections
+			if (!touches(Category::Connections) || &prev.connections() == &cur.connections()) return;
 
-	findRemovedConnections(*this, connections);
-	findAddedOrMutatedConnections(*this, connections);
+			std::unordered_set<ConnectionPtr> prevConnections(cbegin(prev.connections()), cend(prev.connections()));
+			std::unordered_set<ConnectionPtr> curConnections(cbegin(cur.connections()), cend(cur.connections()));
+			findRemovedConnections(*this, curConnections, connections.changes_);
+			findAddedOrMutatedConnections(*this, prevConnections, connections.changes_);
+		});
+		break;
+	default:
+		assert(false);
+	}
 }
@@ -1,12 +1,46 @@
 #pragma once
 #include "static.h"
+#include "document.h"
 
 BEGIN_NAMESPACE(Core)
 
+// Every change set is computed the first time it is used, so listeners only pay for what they look at
 struct MutationInfo
 {
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl_;
+
+public:
+	enum class Category: int
+	{
+		None = 0,
+		Nodes = 1,
+		Properties = 2,
+		Connectors = 4,
+		Connections = 8,
+		Settings = 16,
+		All = Nodes | Properties | Connectors | Connections | Settings
+	};
+
+	friend constexpr Category operator&(Category lhs, Category rhs) { return static_cast<Category>(static_cast<int>(lhs) & static_cast<int>(rhs)); }
+	friend constexpr Category operator|(Category lhs, Category rhs) { return static_cast<Category>(static_cast<int>(lhs) | static_cast<int>(rhs)); }
+
+	// Diffs both documents, only subtrees that differ are visited
 	MutationInfo(const Document& prev, const Document& cur);
 
+	// Only looks at the nodes named in the operations that lead from one document to the other
+	MutationInfo(const Document& prev, const Document& cur, const Document::operations_t& operations);
+
+	~MutationInfo();
+
+	MutationInfo(const MutationInfo&) = delete;
+	MutationInfo& operator=(const MutationInfo&) = delete;
+
+	// The categories that may have changed, known without computing any change set
+	Category categories() const noexcept;
+	bool touches(Category categories) const noexcept { return (this->categories() & categories) != Category::None; }
+
 	enum class ChangeType { Added, Removed, Mutated };
 
 	template <typename T>
@@ -19,6 +53,7 @@ struct MutationInfo
 		NodePtr curParent;
 		size_t prevIndex;
 		size_t curIndex;
+		std::shared_ptr<const Property::KeyChanges> keys; // only for mutated properties
 
 		Change(const T prev, const T cur, ChangeType type, const NodePtr prevParent, const NodePtr curParent, size_t prevIndex, size_t curIndex)
 			: prev(prev)
@@ -72,16 +107,47 @@ struct MutationInfo
 	template <typename T>
 	using ChangeSet = std::vector<Change<T>>;
 
-	ChangeSet<NodePtr> nodes;
-	ChangeSet<PropertyPtr> properties;
-	ChangeSet<ConnectorMetadataPtr> connectors;
-	ChangeSet<ConnectionPtr> connections;
+	template <typename T>
+	class LazyChangeSet
+	{
+	public:
+		using value_type = Change<T>;
+		using const_iterator = typename ChangeSet<T>::const_iterator;
+		using iterator = const_iterator;
+
+		// Safe to call from several threads at once
+		const ChangeSet<T>& get() const { info_.compute(category_); return changes_; }
+		operator const ChangeSet<T>&() const { return get(); }
+
+		const_iterator begin() const { return get().begin(); }
+		const_iterator end() const { return get().end(); }
+		size_t size() const { return get().size(); }
+		bool empty() const { return get().empty(); }
+		const Change<T>& at(size_t index) const { return get().at(index); }
+		const Change<T>& operator[](size_t index) const { return get()[index]; }
+
+		friend std::ostream& operator<<(std::ostream& out, const LazyChangeSet& c) { out << c.get(); return out; }
+
+	private:
+		friend struct MutationInfo;
+		LazyChangeSet(const MutationInfo& info, Category category): info_(info), category_(category) {}
+
+		const MutationInfo& info_;
+		Category category_;
+		mutable ChangeSet<T> changes_;
+	};
+
+	LazyChangeSet<NodePtr> nodes { *this, Category::Nodes };
+	LazyChangeSet<PropertyPtr> properties { *this, Category::Properties };
+	LazyChangeSet<ConnectorMetadataPtr> connectors { *this, Category::Connectors };
+	LazyChangeSet<ConnectionPtr> connections { *this, Category::Connections };
 
+	// Copies of the documents, kept so the change sets can be computed after the project moved on
 	const Document& prev;
 	const Document& cur;
 
-	std::vector<NodePtr> prevNodes;
-	std::vector<NodePtr> curNodes;
+private:
+	void compute(Category category) const;
 };
 
 END_NAMESPACE(Core)
\ No newline at end of file
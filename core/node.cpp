@@ -1,7 +1,9 @@
 #include "node.h"
 #include "metadata.h"
 #include "factory.h"
+#include <algorithm>
 
+using Core::Frame;
 using Core::Node;
 using Core::Uuid;
 using Core::Factory;
@@ -100,6 +102,11 @@ const ConnectorMetadataCollection& Node::connectorMetadata() const
 	return impl_->combinedConnectorMetadata_;
 }
 
+bool Node::isTimeInvariant(Frame first, Frame last) const noexcept
+{
+	return std::all_of(cbegin(impl_->properties_), cend(impl_->properties_), [&](const PropertyPtr& property) { return property->isConstant(first, last); });
+}
+
 const visibility_t Node::visibility() const noexcept
 {
 	return impl_->visibility_;
@@ -208,3 +215,5 @@ void Node::load(Archive& archive)
 
 template void Node::save<cereal::JSONOutputArchive>(cereal::JSONOutputArchive& archive) const;
 template void Node::load<cereal::JSONInputArchive>(cereal::JSONInputArchive& archive);
+template void Node::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Node::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
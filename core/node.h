@@ -29,6 +29,9 @@ public:
 	const ConnectorMetadataCollection& connectorMetadata() const;
 	const visibility_t visibility() const noexcept;
 
+	// None of the properties change in [first, last], so anything computed from them at one frame holds for all of them
+	bool isTimeInvariant(Frame first, Frame last) const noexcept;
+
 	class Builder
 	{
 	public:
@@ -0,0 +1,570 @@
+#include "node_tree.h"
+#include "node.h"
+#include <algorithm>
+#include <atomic>
+
+using Core::Node;
+using Core::NodeTree;
+using Core::NodePtr;
+using Core::MutableNodePtr;
+using Core::Uuid;
+using BranchPtr = NodeTree::BranchPtr;
+using Branch = NodeTree::Branch;
+using Edit = NodeTree::Edit;
+
+// Below this many children, looking for one is quicker than numbering all of them
+static const size_t MAX_LINEAR_POSITION = 16;
+
+static uint64_t newSession() noexcept
+{
+	static std::atomic<uint64_t> lastSession { 0 };
+	return ++lastSession;
+}
+
+static size_t combine(size_t seed, size_t value) noexcept
+{
+	return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// Only branches edited in the current session have no hash, and all of their ancestors were edited as well
+static void rehash(const Branch& branch) noexcept
+{
+	if (branch.hash) return;
+
+	auto hash = std::hash<const Node*>()(branch.node.get());
+	for (auto&& child : branch.children)
+	{
+		rehash(*child);
+		hash = combine(hash, child->hash);
+	}
+	const_cast<Branch&>(branch).hash = hash ? hash : 1;
+}
+
+// Branches shared by both trees aren't visited, the hash of a branch that is still being edited is unknown
+static bool sameBranch(const Branch& lhs, const Branch& rhs) noexcept
+{
+	if (&lhs == &rhs) return true;
+	if (lhs.hash && rhs.hash && lhs.hash != rhs.hash) return false;
+	if (lhs.node != rhs.node || lhs.size != rhs.size || lhs.children.size() != rhs.children.size()) return false;
+
+	for (size_t t = 0; t < lhs.children.size(); t++)
+	{
+		if (!sameBranch(*lhs.children[t], *rhs.children[t])) return false;
+	}
+	return true;
+}
+
+NodeTree::const_iterator& NodeTree::const_iterator::operator++() noexcept
+{
+	if (!current_->children.empty())
+	{
+		parents_.emplace_back(current_, 0);
+		current_ = current_->children.front().get();
+		return *this;
+	}
+
+	while (!parents_.empty())
+	{
+		auto& top = parents_.back();
+		if (++top.second < top.first->children.size())
+		{
+			current_ = top.first->children[top.second].get();
+			return *this;
+		}
+		parents_.pop_back();
+	}
+
+	current_ = nullptr;
+	return *this;
+}
+
+NodeTree::NodeTree(NodePtr root)
+{
+	auto branch = std::make_shared<Branch>();
+	branch->node = root;
+	branch->size = 1;
+	root_ = branch;
+	indexSubtree(root_, Uuid());
+	rehash(*root_);
+}
+
+NodeTree::NodeTree(const NodeTree& rhs)
+	: root_(rhs.root_)
+	, index_(rhs.index_)
+{
+	// Both trees now share every branch, so neither of them may keep editing in place
+	rhs.endSession();
+}
+
+NodeTree& NodeTree::operator=(const NodeTree& rhs)
+{
+	root_ = rhs.root_;
+	index_ = rhs.index_;
+	session_ = 0;
+	rhs.endSession();
+	return *this;
+}
+
+NodeTree::NodeTree(NodeTree&& rhs) noexcept = default;
+NodeTree& NodeTree::operator=(NodeTree&& rhs) noexcept = default;
+
+bool NodeTree::operator==(const NodeTree& rhs) const noexcept
+{
+	if (root_ == rhs.root_) return true;
+	return root_ && rhs.root_ && sameBranch(*root_, *rhs.root_);
+}
+
+BranchPtr NodeTree::branch(const Uuid& uuid) const noexcept
+{
+	auto entry = index_.find(uuid);
+	if (!entry) return nullptr;
+	return entry->branch;
+}
+
+NodePtr NodeTree::find(const Uuid& uuid) const noexcept
+{
+	auto entry = index_.find(uuid);
+	if (!entry) return nullptr;
+	return entry->branch->node;
+}
+
+NodePtr NodeTree::parent(const Uuid& uuid) const noexcept
+{
+	auto& parent = entry(uuid).parent;
+	if (parent.isEmpty()) return nullptr; // root has no parent
+	return entry(parent).branch->node;
+}
+
+NodePtr NodeTree::child(const Uuid& parent, size_t index) const noexcept
+{
+	auto& children = entry(parent).branch->children;
+	assert(index < children.size());
+	return children[index]->node;
+}
+
+size_t NodeTree::childIndex(const Uuid& uuid) const noexcept
+{
+	auto& e = entry(uuid);
+	if (e.parent.isEmpty()) return 0;
+	return position(*entry(e.parent).branch, uuid);
+}
+
+size_t NodeTree::childCount(const Uuid& uuid) const noexcept
+{
+	return entry(uuid).branch->children.size();
+}
+
+void NodeTree::replace(NodePtr node) noexcept
+{
+	auto branch = editable(node->uuid());
+	log(Edit::Type::Replace, node->uuid(), {}, 0, node, branch->node);
+	branch->node = node;
+}
+
+void NodeTree::insert(const Uuid& parent, size_t index, NodePtr node) noexcept
+{
+	insert(parent, index, std::vector<NodePtr> { node });
+}
+
+void NodeTree::insert(const Uuid& parent, size_t index, const std::vector<NodePtr>& nodes) noexcept
+{
+	if (!session_) session_ = newSession();
+
+	std::vector<BranchPtr> subtrees;
+	subtrees.reserve(nodes.size());
+	for (auto&& node : nodes)
+	{
+		auto branch = std::make_shared<Branch>();
+		branch->node = node;
+		branch->size = 1;
+		branch->owner = session_;
+		subtrees.emplace_back(branch);
+	}
+	attach(parent, index, subtrees, Edit::Type::Insert);
+}
+
+void NodeTree::insert(const Uuid& parent, size_t index, BranchPtr subtree) noexcept
+{
+	attach(parent, index, { subtree }, Edit::Type::Insert);
+}
+
+BranchPtr NodeTree::erase(const Uuid& uuid) noexcept
+{
+	auto subtree = detach(uuid, Edit::Type::Erase);
+	unindexSubtree(*subtree);
+	return subtree;
+}
+
+std::vector<BranchPtr> NodeTree::erase(const std::vector<Uuid>& uuids) noexcept
+{
+	auto subtrees = detach(uuids, Edit::Type::Erase);
+	for (auto&& subtree : subtrees) unindexSubtree(*subtree);
+	return subtrees;
+}
+
+std::vector<BranchPtr> NodeTree::eraseChildren(const Uuid& uuid) noexcept
+{
+	if (entry(uuid).branch->children.empty()) return {};
+
+	auto branch = editable(uuid);
+	std::vector<BranchPtr> children;
+	children.swap(branch->children);
+	branch->positions.map.reset();
+	for (auto&& child : children) unindexSubtree(*child);
+	for (auto index = children.size(); index-- > 0;) log(Edit::Type::Erase, children[index]->node->uuid(), uuid, index, children[index]->node, nullptr, children[index]);
+
+	resize(uuid, -static_cast<std::ptrdiff_t>(branch->size - 1));
+	return children;
+}
+
+void NodeTree::move(const std::vector<Uuid>& uuids, const Uuid& parent, size_t index) noexcept
+{
+	attach(parent, index, detach(uuids, Edit::Type::Detach), Edit::Type::Attach);
+}
+
+void NodeTree::moveAfter(const std::vector<Uuid>& uuids, const Uuid& sibling) noexcept
+{
+	auto subtrees = detach(uuids, Edit::Type::Detach);
+	// A copy, the entry is gone once attach starts editing the index
+	auto parent = entry(sibling).parent;
+	attach(parent, childIndex(sibling) + 1, subtrees, Edit::Type::Attach);
+}
+
+void NodeTree::apply(const edits_t& edits, bool inverse) noexcept
+{
+	auto journal = journal_;
+	journal_ = nullptr;
+
+	// Subtrees that were taken out to be attached somewhere else
+	std::unordered_map<Uuid, BranchPtr> detached;
+
+	auto step = [&](const Edit& edit)
+	{
+		auto type = edit.type;
+		if (inverse)
+		{
+			switch (type)
+			{
+			case Edit::Type::Insert: type = Edit::Type::Erase; break;
+			case Edit::Type::Erase: type = Edit::Type::Insert; break;
+			case Edit::Type::Detach: type = Edit::Type::Attach; break;
+			case Edit::Type::Attach: type = Edit::Type::Detach; break;
+			case Edit::Type::Replace: break;
+			}
+		}
+
+		switch (type)
+		{
+		case Edit::Type::Insert:
+			if (edit.subtree) insert(edit.parent, edit.index, edit.subtree);
+			else insert(edit.parent, edit.index, edit.node);
+			break;
+		// The logged index is where the node is at this point of the replay, so it doesn't have to be looked up
+		case Edit::Type::Erase:
+			unindexSubtree(*detach(edit.uuid, Edit::Type::Erase, edit.index));
+			break;
+		case Edit::Type::Detach:
+			detached[edit.uuid] = detach(edit.uuid, Edit::Type::Detach, edit.index);
+			break;
+		case Edit::Type::Attach:
+			attach(edit.parent, edit.index, { detached[edit.uuid] }, Edit::Type::Attach);
+			break;
+		case Edit::Type::Replace:
+			replace(inverse ? edit.previous : edit.node);
+			break;
+		}
+	};
+
+	if (inverse) for (auto it = edits.rbegin(); it != edits.rend(); ++it) step(*it);
+	else for (auto&& edit : edits) step(edit);
+
+	journal_ = journal;
+}
+
+void NodeTree::endSession() const noexcept
+{
+	if (!session_) return;
+	rehash(*root_);
+	session_ = 0;
+}
+
+const NodeTree::Entry& NodeTree::entry(const Uuid& uuid) const noexcept
+{
+	auto entry = index_.find(uuid);
+	assert(entry);
+	return *entry;
+}
+
+Branch* NodeTree::editable(const Uuid& uuid) noexcept
+{
+	if (!session_) session_ = newSession();
+
+	auto& branch = entry(uuid).branch;
+	if (branch->owner == session_)
+	{
+		auto result = const_cast<Branch*>(branch.get());
+		result->hash = 0;
+		return result;
+	}
+
+	// Path copy: this branch is shared with other versions, so copy it and link the copy into an editable parent
+	auto copy = std::make_shared<Branch>(*branch);
+	copy->owner = session_;
+	copy->hash = 0;
+	rebind(uuid, copy);
+	return copy.get();
+}
+
+void NodeTree::rebind(const Uuid& uuid, const BranchPtr& branch) noexcept
+{
+	auto e = entry(uuid);
+	index_.set(uuid, { branch, e.parent });
+
+	if (e.parent.isEmpty())
+	{
+		root_ = branch;
+		return;
+	}
+
+	// The copy has the same uuid, so the positions of the siblings stay the same
+	auto parent = editable(e.parent);
+	auto& child = parent->children[position(*parent, uuid)];
+	assert(child == e.branch);
+	child = branch;
+}
+
+void NodeTree::resize(const Uuid& uuid, std::ptrdiff_t delta) noexcept
+{
+	for (auto current = uuid; !current.isEmpty(); current = entry(current).parent)
+	{
+		auto branch = editable(current);
+		branch->size = static_cast<size_t>(static_cast<std::ptrdiff_t>(branch->size) + delta);
+	}
+}
+
+size_t NodeTree::depth(const Uuid& uuid) const noexcept
+{
+	size_t result = 0;
+	for (auto current = entry(uuid).parent; !current.isEmpty(); current = entry(current).parent) result++;
+	return result;
+}
+
+size_t NodeTree::position(const Branch& parent, const Uuid& uuid, size_t hint) const noexcept
+{
+	auto& children = parent.children;
+	if (hint < children.size() && children[hint]->node->uuid() == uuid) return hint;
+
+	if (children.size() <= MAX_LINEAR_POSITION)
+	{
+		auto it = std::find_if(std::cbegin(children), std::cend(children), [&](auto& child) { return child->node->uuid() == uuid; });
+		assert(it != std::cend(children));
+		return distance(std::cbegin(children), it);
+	}
+
+	// Numbered once for every version of the children, copies of the parent made by later edits keep the numbers
+	auto positions = std::atomic_load(&parent.positions.map);
+	if (!positions)
+	{
+		auto map = std::make_shared<std::unordered_map<Uuid, size_t>>();
+		map->reserve(children.size());
+		for (size_t index = 0; index < children.size(); index++) map->emplace(children[index]->node->uuid(), index);
+		positions = map;
+		std::atomic_store(&parent.positions.map, positions);
+	}
+
+	auto it = positions->find(uuid);
+	assert(it != positions->end());
+	return it->second;
+}
+
+BranchPtr NodeTree::detach(const Uuid& uuid, Edit::Type type, size_t hint) noexcept
+{
+	auto e = entry(uuid);
+	assert(!e.parent.isEmpty()); // the root can't be detached
+
+	auto parent = editable(e.parent);
+	auto index = position(*parent, uuid, hint);
+	assert(parent->children[index] == e.branch);
+	log(type, uuid, e.parent, index, e.branch->node, nullptr, type == Edit::Type::Erase ? e.branch : nullptr);
+	parent->children.erase(std::begin(parent->children) + index);
+	parent->positions.map.reset();
+
+	resize(e.parent, -static_cast<std::ptrdiff_t>(e.branch->size));
+	return e.branch;
+}
+
+std::vector<BranchPtr> NodeTree::detach(const std::vector<Uuid>& uuids, Edit::Type type) noexcept
+{
+	// Group the nodes by parent, so every parent is edited once no matter how many children it loses
+	std::unordered_map<Uuid, std::unordered_set<Uuid>> groups;
+	std::vector<std::pair<size_t, Uuid>> parents;
+	for (auto&& uuid : uuids)
+	{
+		auto& parent = entry(uuid).parent;
+		assert(!parent.isEmpty()); // the root can't be detached
+
+		auto& group = groups[parent];
+		if (group.empty()) parents.emplace_back(depth(parent), parent);
+		group.emplace(uuid);
+	}
+
+	// Deepest parents first, a parent that is detached itself must still be in the tree while it loses its children
+	std::stable_sort(std::begin(parents), std::end(parents), [](auto& lhs, auto& rhs) { return lhs.first > rhs.first; });
+
+	std::unordered_map<Uuid, BranchPtr> detached;
+	for (auto&& parent : parents)
+	{
+		auto& group = groups[parent.second];
+		auto branch = editable(parent.second);
+		auto& siblings = branch->children;
+		branch->positions.map.reset();
+
+		// Logged from the back, so every logged index is still right when the edits are replayed one by one
+		if (journal_)
+		{
+			for (auto index = siblings.size(); index-- > 0;)
+			{
+				auto& child = siblings[index];
+				if (group.count(child->node->uuid())) log(type, child->node->uuid(), parent.second, index, child->node, nullptr, type == Edit::Type::Erase ? child : nullptr);
+			}
+		}
+
+		std::ptrdiff_t removed = 0;
+		auto it = std::remove_if(std::begin(siblings), std::end(siblings), [&](auto& child)
+		{
+			if (!group.count(child->node->uuid())) return false;
+			removed += child->size;
+			detached.emplace(child->node->uuid(), child);
+			return true;
+		});
+		siblings.erase(it, std::end(siblings));
+
+		resize(parent.second, -removed);
+	}
+
+	std::vector<BranchPtr> result;
+	result.reserve(uuids.size());
+	for (auto&& uuid : uuids) result.emplace_back(detached[uuid]);
+	return result;
+}
+
+void NodeTree::attach(const Uuid& parent, size_t index, const std::vector<BranchPtr>& subtrees, Edit::Type type) noexcept
+{
+	auto branch = editable(parent);
+	auto& siblings = branch->children;
+	if (index == npos) index = siblings.size();
+	assert(index <= siblings.size());
+	siblings.insert(std::begin(siblings) + index, std::begin(subtrees), std::end(subtrees));
+	branch->positions.map.reset();
+
+	if (journal_)
+	{
+		for (size_t t = 0; t < subtrees.size(); t++)
+		{
+			// A new leaf is logged by its node, it may still be edited in place later on in this session
+			auto& subtree = subtrees[t];
+			auto leaf = type == Edit::Type::Insert && subtree->owner == session_ && subtree->children.empty();
+			log(type, subtree->node->uuid(), parent, index + t, subtree->node, nullptr, type == Edit::Type::Insert && !leaf ? subtree : nullptr);
+		}
+	}
+
+	std::ptrdiff_t added = 0;
+	for (auto&& subtree : subtrees)
+	{
+		added += subtree->size;
+
+		// Only the top of a moved subtree changes parent, but a newly attached subtree isn't indexed yet at all
+		auto e = index_.find(subtree->node->uuid());
+		if (e && e->branch == subtree) index_.set(subtree->node->uuid(), { subtree, parent });
+		else indexSubtree(subtree, parent);
+	}
+
+	resize(parent, added);
+}
+
+void NodeTree::log(Edit::Type type, const Uuid& uuid, const Uuid& parent, size_t index, const NodePtr& node, const NodePtr& previous, const BranchPtr& subtree) noexcept
+{
+	if (journal_) journal_->push_back({ type, uuid, parent, index, node, previous, subtree });
+}
+
+void NodeTree::indexSubtree(const BranchPtr& subtree, const Uuid& parent) noexcept
+{
+	auto uuid = subtree->node->uuid();
+	assert(!index_.find(uuid) || index_.find(uuid)->branch == subtree);
+	index_.set(uuid, { subtree, parent });
+	for (auto&& child : subtree->children) indexSubtree(child, uuid);
+}
+
+void NodeTree::unindexSubtree(const Branch& subtree) noexcept
+{
+	index_.erase(subtree.node->uuid());
+	for (auto&& child : subtree.children) unindexSubtree(*child);
+}
+
+///
+
+template<class Archive>
+static void saveBranch(Archive& archive, const Branch& branch)
+{
+	archive(branch.node);
+	archive(branch.children.size());
+	for (auto&& child : branch.children) saveBranch(archive, *child);
+}
+
+// Loaded branches have no hash and no owner, they are hashed when they are attached to a tree
+template<class Archive>
+static BranchPtr loadBranch(Archive& archive)
+{
+	auto branch = std::make_shared<Branch>();
+
+	MutableNodePtr node;
+	archive(node);
+	branch->node = node;
+	branch->size = 1;
+
+	size_t children;
+	archive(children);
+	for (size_t t = 0; t < children; t++)
+	{
+		auto child = loadBranch(archive);
+		branch->size += child->size;
+		branch->children.emplace_back(std::move(child));
+	}
+	return branch;
+}
+
+template<class Archive>
+void Edit::save(Archive& archive) const
+{
+	archive(type);
+	archive(uuid);
+	archive(parent);
+	archive(index);
+	archive(node);
+	archive(previous);
+
+	archive(subtree != nullptr);
+	if (subtree) saveBranch(archive, *subtree);
+}
+
+template<class Archive>
+void Edit::load(Archive& archive)
+{
+	archive(type);
+	archive(uuid);
+	archive(parent);
+	archive(index);
+
+	MutableNodePtr node, previous;
+	archive(node);
+	archive(previous);
+	this->node = node;
+	this->previous = previous;
+
+	bool hasSubtree;
+	archive(hasSubtree);
+	subtree = hasSubtree ? loadBranch(archive) : nullptr;
+}
+
+template void Edit::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Edit::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
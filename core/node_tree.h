@@ -0,0 +1,171 @@
+#pragma once
+#include "static.h"
+#include "hash_trie.h"
+
+BEGIN_NAMESPACE(Core)
+
+// Persistent node hierarchy.
+// Every subtree is an immutable Branch that is shared between all versions of the tree it appears in.
+// Copying a tree is O(1), and an edit only copies the branches on the path from the edited node to the root,
+// so consecutive versions (e.g. the documents in the undo history) only pay for what actually changed.
+// Within one editing session, branches that were already copied by that session are modified in place.
+// Every branch carries a hash of its node pointer and its children's hashes in order, so identical subtrees
+// can be recognized without visiting them. Hashes are brought up to date when a session ends.
+class NodeTree
+{
+public:
+	struct Branch
+	{
+		NodePtr node;
+		std::vector<std::shared_ptr<const Branch>> children;
+		size_t size {}; // number of nodes in this subtree, including node itself
+		uint64_t owner {}; // editing session that is allowed to modify this branch in place
+		size_t hash {}; // 0 while the branch is being edited
+
+		// Index of every child by uuid, built on demand and shared with copies that have the same children.
+		// Threads reading a shared branch may build it at the same time, so it is only accessed atomically.
+		struct Positions
+		{
+			Positions() = default;
+			Positions(const Positions& rhs) noexcept: map(std::atomic_load(&rhs.map)) {}
+			Positions& operator=(const Positions& rhs) noexcept { std::atomic_store(&map, std::atomic_load(&rhs.map)); return *this; }
+
+			mutable std::shared_ptr<const std::unordered_map<Uuid, size_t>> map;
+		} positions;
+	};
+	using BranchPtr = std::shared_ptr<const Branch>;
+
+	// One primitive change to the tree. A list of them replays an edit forwards, or backwards in reverse order.
+	struct Edit
+	{
+		enum class Type
+		{
+			Insert, // adds subtree, or a new leaf for node
+			Erase, // the opposite of Insert
+			Detach, // takes uuid out of the tree for a later Attach
+			Attach, // the opposite of Detach
+			Replace // swaps previous for node
+		};
+
+		Type type;
+		Uuid uuid;
+		Uuid parent;
+		size_t index;
+		NodePtr node;
+		NodePtr previous;
+		BranchPtr subtree; // what was erased, so it can be put back
+
+		template<class Archive> void save(Archive& archive) const;
+		template<class Archive> void load(Archive& archive);
+	};
+	using edits_t = std::vector<Edit>;
+
+	class const_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = NodePtr;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const NodePtr*;
+		using reference = const NodePtr&;
+
+		const_iterator() = default;
+		explicit const_iterator(const Branch* root): current_(root) {}
+
+		reference operator*() const noexcept { return current_->node; }
+		pointer operator->() const noexcept { return &current_->node; }
+
+		const_iterator& operator++() noexcept;
+		const_iterator operator++(int) noexcept { auto result = *this; ++*this; return result; }
+
+		friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs.current_ == rhs.current_; }
+		friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return lhs.current_ != rhs.current_; }
+
+	private:
+		const Branch* current_ {};
+		std::vector<std::pair<const Branch*, size_t>> parents_; // parent branch + index of the child being visited
+	};
+	using iterator = const_iterator;
+
+	NodeTree() = default;
+	explicit NodeTree(NodePtr root);
+
+	NodeTree(const NodeTree& rhs);
+	NodeTree& operator=(const NodeTree& rhs);
+
+	NodeTree(NodeTree&& rhs) noexcept;
+	NodeTree& operator=(NodeTree&& rhs) noexcept;
+
+	const_iterator begin() const noexcept { return const_iterator(root_.get()); }
+	const_iterator end() const noexcept { return const_iterator(); }
+
+	bool empty() const noexcept { return !root_; }
+	size_t size() const noexcept { return root_ ? root_->size : 0; }
+
+	const NodePtr& root() const noexcept { return root_->node; }
+	const BranchPtr& rootBranch() const noexcept { return root_; }
+
+	BranchPtr branch(const Uuid& uuid) const noexcept;
+	NodePtr find(const Uuid& uuid) const noexcept;
+	NodePtr parent(const Uuid& uuid) const noexcept;
+	NodePtr child(const Uuid& parent, size_t index) const noexcept;
+	size_t childIndex(const Uuid& uuid) const noexcept;
+	size_t childCount(const Uuid& uuid) const noexcept;
+
+	// Stops editing branches in place and updates the hashes, call this before the tree is shared with other threads
+	void seal() noexcept { endSession(); }
+	size_t hash() const noexcept { return root_ ? root_->hash : 0; }
+
+	// Same nodes in the same places. Hashes only rule trees out, equal ones are compared branch by branch.
+	bool operator==(const NodeTree& rhs) const noexcept;
+	bool operator!=(const NodeTree& rhs) const noexcept { return !(*this == rhs); }
+
+	// Pass as index to add at the end of the parent's children
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+	void replace(NodePtr node) noexcept;
+	void insert(const Uuid& parent, size_t index, NodePtr node) noexcept;
+	void insert(const Uuid& parent, size_t index, const std::vector<NodePtr>& nodes) noexcept;
+	void insert(const Uuid& parent, size_t index, BranchPtr subtree) noexcept;
+	BranchPtr erase(const Uuid& uuid) noexcept;
+	std::vector<BranchPtr> erase(const std::vector<Uuid>& uuids) noexcept;
+	std::vector<BranchPtr> eraseChildren(const Uuid& uuid) noexcept;
+
+	// Nodes keep the given order, index is the position in the new parent after they were taken out of their old parents
+	void move(const std::vector<Uuid>& uuids, const Uuid& parent, size_t index) noexcept;
+	void moveAfter(const std::vector<Uuid>& uuids, const Uuid& sibling) noexcept;
+
+	// Appends every following change to journal, until it is called with nullptr. Copies don't record.
+	void record(edits_t* journal) noexcept { journal_ = journal; }
+
+	// Replays recorded edits on the tree they were recorded on, or with inverse on the tree they produced
+	void apply(const edits_t& edits, bool inverse) noexcept;
+
+private:
+	struct Entry
+	{
+		BranchPtr branch;
+		Uuid parent;
+	};
+
+	void endSession() const noexcept;
+	const Entry& entry(const Uuid& uuid) const noexcept;
+	Branch* editable(const Uuid& uuid) noexcept;
+	void rebind(const Uuid& uuid, const BranchPtr& branch) noexcept;
+	void resize(const Uuid& uuid, std::ptrdiff_t delta) noexcept;
+	size_t depth(const Uuid& uuid) const noexcept;
+	size_t position(const Branch& parent, const Uuid& uuid, size_t hint = npos) const noexcept;
+	BranchPtr detach(const Uuid& uuid, Edit::Type type, size_t hint = npos) noexcept;
+	std::vector<BranchPtr> detach(const std::vector<Uuid>& uuids, Edit::Type type) noexcept;
+	void attach(const Uuid& parent, size_t index, const std::vector<BranchPtr>& subtrees, Edit::Type type) noexcept;
+	void log(Edit::Type type, const Uuid& uuid, const Uuid& parent, size_t index, const NodePtr& node = nullptr, const NodePtr& previous = nullptr, const BranchPtr& subtree = nullptr) noexcept;
+	void indexSubtree(const BranchPtr& subtree, const Uuid& parent) noexcept;
+	void unindexSubtree(const Branch& subtree) noexcept;
+
+	BranchPtr root_;
+	HashTrie<Uuid, Entry> index_;
+	mutable uint64_t session_ {}; // reset on copy, so the source of a copy stops editing shared branches too
+	edits_t* journal_ {};
+};
+
+END_NAMESPACE(Core)
@@ -0,0 +1,216 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+using Core::parallel_fn;
+using Core::SerialQueue;
+
+namespace {
+
+class Job
+{
+public:
+	Job(size_t count, size_t chunkSize, size_t chunks, const parallel_fn& fn)
+		: count_(count)
+		, chunkSize_(chunkSize)
+		, chunks_(chunks)
+		, fn_(fn)
+	{}
+
+	// Runs chunks until there are none left to start, fn_ is never touched after the last chunk finished
+	void run() noexcept
+	{
+		for (size_t chunk; (chunk = next_++) < chunks_;)
+		{
+			auto first = chunk * chunkSize_;
+			fn_(first, std::min(first + chunkSize_, count_), chunk);
+
+			if (++done_ == chunks_)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				finished_.notify_all();
+			}
+		}
+	}
+
+	void wait() noexcept
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		finished_.wait(lock, [&]() { return done_ == chunks_; });
+	}
+
+private:
+	size_t count_;
+	size_t chunkSize_;
+	size_t chunks_;
+	const parallel_fn& fn_;
+
+	std::atomic<size_t> next_ { 0 };
+	std::atomic<size_t> done_ { 0 };
+	std::mutex mutex_;
+	std::condition_variable finished_;
+};
+
+class WorkerPool
+{
+public:
+	static WorkerPool& instance()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto&& thread : threads_) thread.join();
+	}
+
+	size_t size() const noexcept { return threads_.size(); }
+
+	void post(const std::shared_ptr<Job>& job, size_t helpers) noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t t = 0; t < helpers; t++) queue_.push(job);
+		}
+		wake_.notify_all();
+	}
+
+private:
+	WorkerPool()
+	{
+		// The thread calling parallelFor does its share of the work too
+		auto workers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+		for (unsigned t = 0; t < workers; t++) threads_.emplace_back([this]() { work(); });
+	}
+
+	void work() noexcept
+	{
+		for (;;)
+		{
+			std::shared_ptr<Job> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [&]() { return stop_ || !queue_.empty(); });
+				if (queue_.empty()) return;
+
+				job = std::move(queue_.front());
+				queue_.pop();
+			}
+			job->run();
+		}
+	}
+
+	std::vector<std::thread> threads_;
+	std::queue<std::shared_ptr<Job>> queue_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stop_ {};
+};
+
+// A few chunks per thread, so a slow chunk doesn't hold up the others
+size_t chunkSize(size_t count, size_t grainSize) noexcept
+{
+	auto threads = WorkerPool::instance().size() + 1;
+	auto chunks = threads * 4;
+	return std::max(std::max(grainSize, size_t(1)), (count + chunks - 1) / chunks);
+}
+
+}
+
+size_t Core::parallelChunks(size_t count, size_t grainSize) noexcept
+{
+	auto size = chunkSize(count, grainSize);
+	return (count + size - 1) / size;
+}
+
+void Core::parallelFor(size_t count, size_t grainSize, const parallel_fn& fn) noexcept
+{
+	auto size = chunkSize(count, grainSize);
+	auto chunks = (count + size - 1) / size;
+	if (!chunks) return;
+
+	auto& pool = WorkerPool::instance();
+	if (chunks == 1 || !pool.size())
+	{
+		for (size_t chunk = 0; chunk < chunks; chunk++) fn(chunk * size, std::min((chunk + 1) * size, count), chunk);
+		return;
+	}
+
+	auto job = std::make_shared<Job>(count, size, chunks, fn);
+	pool.post(job, std::min(chunks - 1, pool.size()));
+	job->run();
+	job->wait();
+}
+
+struct SerialQueue::Impl
+{
+	std::queue<job_fn> jobs;
+	bool busy {};
+	bool stop {};
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::thread thread;
+
+	void run() noexcept
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			wake.wait(lock, [&]() { return stop || !jobs.empty(); });
+			if (jobs.empty()) return;
+
+			auto job = std::move(jobs.front());
+			jobs.pop();
+			busy = true;
+
+			lock.unlock();
+			job();
+			lock.lock();
+
+			busy = false;
+			if (jobs.empty()) idle.notify_all();
+		}
+	}
+};
+
+SerialQueue::SerialQueue()
+	: impl_(std::make_unique<Impl>())
+{
+	impl_->thread = std::thread([this]() { impl_->run(); });
+}
+
+SerialQueue::~SerialQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(impl_->mutex);
+		impl_->stop = true;
+	}
+	impl_->wake.notify_all();
+	impl_->thread.join();
+}
+
+void SerialQueue::post(job_fn job) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(impl_->mutex);
+		impl_->jobs.push(std::move(job));
+	}
+	impl_->wake.notify_one();
+}
+
+void SerialQueue::wait() noexcept
+{
+	std::unique_lock<std::mutex> lock(impl_->mutex);
+	impl_->idle.wait(lock, [&]() { return impl_->jobs.empty() && !impl_->busy; });
+}
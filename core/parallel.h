@@ -0,0 +1,40 @@
+#pragma once
+#include "static.h"
+
+BEGIN_NAMESPACE(Core)
+
+// Splits [0, count) into consecutive chunks of at least grainSize items and runs fn(first, last, chunk) for each of them
+// on a shared pool of worker threads. The calling thread helps out and only returns once every chunk is done,
+// so it is safe to call this from inside a worker. Chunks are numbered in order, so results that are collected
+// per chunk can be merged into the same order a sequential loop would have produced.
+using parallel_fn = std::function<void(size_t first, size_t last, size_t chunk)>;
+void parallelFor(size_t count, size_t grainSize, const parallel_fn& fn) noexcept;
+
+// The number of chunks parallelFor will use for the same arguments
+size_t parallelChunks(size_t count, size_t grainSize) noexcept;
+
+// Runs jobs one at a time in the order they were posted, on a thread of its own.
+// Destroying the queue runs whatever was still waiting first.
+class SerialQueue
+{
+	struct Impl;
+
+public:
+	using job_fn = std::function<void()>;
+
+	SerialQueue();
+	~SerialQueue();
+
+	SerialQueue(const SerialQueue&) = delete;
+	SerialQueue& operator=(const SerialQueue&) = delete;
+
+	void post(job_fn job) noexcept;
+
+	// Blocks until every job posted so far has run
+	void wait() noexcept;
+
+private:
+	std::unique_ptr<Impl> impl_;
+};
+
+END_NAMESPACE(Core)
@@ -1,47 +1,64 @@
 #include "project.h"
 #include "mutation_info.h"
+#include <sstream>
 
 using Core::Document;
 using Core::MutationInfo;
 using Core::NodePtr;
 using Core::Project;
 
+static size_t memoryUsage(const Project::history_group_t& group) noexcept
+{
+	return sizeof(group) + group.description.capacity() + group.operations.capacity() * sizeof(Document::Operation) + group.delta.memoryUsage();
+}
+
 Project::Project()
 	: root_(std::make_shared<Node>(HashValue()))
 {
-	history_.push_back({ "New project", { Document::buildRootDocument(root_) } });
+	current_ = Document::buildRootDocument(root_);
+	history_.push_back({ "New project", {}, {} });
 }
 
 void Project::undo() noexcept
 {
 	assert(history_.size() > 1);
+	assert(!inTransaction());
+
+	// The entry keeps its record when it can't be read, so the history still matches the document
+	if (!restoreHistory(history_.back())) return;
 
 	auto prevCurrent = current();
-	redoStack_.push(history_.back());
+	current_ = current_.apply(history_.back().delta, true);
+	if (journalCallback_) journalCallback_(history_.back().delta, true);
+	redoStack_.push_back(std::move(history_.back()));
 	history_.pop_back();
 	
-	if (mutationCallback_) mutationCallback_(std::make_shared<MutationInfo>(prevCurrent, current()));
+	if (hasMutationCallback()) emitMutation(std::make_shared<MutationInfo>(prevCurrent, current(), redoStack_.back().operations));
 }
 
 void Project::redo() noexcept
 {
 	assert(!redoStack_.empty());
+	assert(!inTransaction());
 
 	auto prevCurrent = current();
-	history_.push_back(redoStack_.top());
-	redoStack_.pop();
+	current_ = current_.apply(redoStack_.back().delta);
+	if (journalCallback_) journalCallback_(redoStack_.back().delta, false);
+	history_.push_back(std::move(redoStack_.back()));
+	redoStack_.pop_back();
 
-	if (mutationCallback_) mutationCallback_(std::make_shared<MutationInfo>(prevCurrent, current()));
+	if (hasMutationCallback()) emitMutation(std::make_shared<MutationInfo>(prevCurrent, current(), history_.back().operations));
+	spillHistory();
 }
 
 Project::UndoState Project::undoState() const noexcept
 {
-	auto canUndo = history_.size() > 1; // first document is creating root, so there should at least be a second document to undo to
+	auto canUndo = history_.size() > 1 && !history_.back().unreadable; // first document is creating root, so there should at least be a second document to undo to
 	auto canRedo = !redoStack_.empty();
 
 	return {
-		canUndo ? history_.at(history_.size() - 1).first : "",
-		canRedo ? redoStack_.top().first : "",
+		canUndo ? history_.at(history_.size() - 1).description : "",
+		canRedo ? redoStack_.back().description : "",
 		canUndo,
 		canRedo
 	};
@@ -49,8 +66,7 @@ Project::UndoState Project::undoState() const noexcept
 
 const Document& Project::current() const noexcept
 {
-	assert(history_.size());
-	return history_.back().second;
+	return current_;
 }
 
 void Project::mutate(mutate_fn fn, std::string description) noexcept
@@ -60,37 +76,261 @@ void Project::mutate(mutate_fn fn, std::string description) noexcept
 
 void Project::mutate(std::initializer_list<mutate_fn> fns, std::string description) noexcept
 {
+	if (inTransaction()) commit();
+
 	// When creating a new mutation, any redo actions that were still on the stack should be removed
-	while (!redoStack_.empty()) redoStack_.pop();
+	clearRedoStack();
 
 	auto originalState = current();
 
-	bool needToReplace = false;
-	for (auto&& fn : fns)
+	// All steps share one builder, so every step sees what the ones before it did and the document is built once
+	auto b = Document::Builder(current());
+	for (auto&& fn : fns) fn(b);
+	b.fixupConnections();
+
+	auto operations = b.operations();
+	auto delta = b.delta();
+	current_ = std::move(b);
+
+	if (journalCallback_) journalCallback_(delta, false);
+	pushHistory({ description, std::move(delta), operations });
+
+	if (hasMutationCallback())
 	{
-		auto b = Document::Builder(current());
-		fn(b);
-		b.fixupConnections();
+		emitMutation(std::make_shared<MutationInfo>(originalState, current(), operations));
+	}
+}
+
+void Project::beginTransaction(std::string description) noexcept
+{
+	assert(!inTransaction());
+	clearRedoStack();
 
-		if (needToReplace) history_.pop_back();
-		history_.push_back({ description, std::move(b) });
-		needToReplace = true;
+	transaction_ = std::make_unique<Transaction>();
+	transaction_->description = description;
+}
+
+void Project::update(mutate_fn fn) noexcept
+{
+	assert(inTransaction());
+
+	auto prevCurrent = current();
+	auto b = Document::Builder(prevCurrent);
+	fn(b);
+	b.fixupConnections();
+
+	auto operations = b.operations();
+	for (auto&& op : operations)
+	{
+		if (op.type == Document::Operation::Type::Mutate && !transaction_->mutated.insert(op.node).second) continue;
+		transaction_->operations.emplace_back(op);
 	}
 
-	if (mutationCallback_)
+	// Extending the pending entry keeps the history at one entry, however many updates there are
+	if (transaction_->updated)
+	{
+		auto& group = history_.back();
+		historyMemoryUsage_ -= group.memoryUsage;
+		group.delta.append(b.delta());
+		group.memoryUsage = memoryUsage(group);
+		historyMemoryUsage_ += group.memoryUsage;
+	}
+	else
 	{
-		mutationCallback_(std::make_shared<MutationInfo>(originalState, current()));
+		history_.push_back({ transaction_->description, b.delta() });
+		history_.back().memoryUsage = memoryUsage(history_.back());
+		historyMemoryUsage_ += history_.back().memoryUsage;
 	}
+	current_ = std::move(b);
+	transaction_->updated = true;
+
+	if (hasMutationCallback()) emitMutation(std::make_shared<MutationInfo>(prevCurrent, current(), operations));
 }
 
-void Project::setMutationCallback(mutation_callback_fn fn) noexcept
+void Project::commit() noexcept
 {
-	mutationCallback_ = fn;
+	assert(inTransaction());
+	auto transaction = std::move(transaction_);
+	if (!transaction->updated) return;
+
+	auto group = std::move(history_.back());
+	historyMemoryUsage_ -= group.memoryUsage;
+	history_.pop_back();
+
+	group.operations = std::move(transaction->operations);
+	if (journalCallback_) journalCallback_(group.delta, false);
+	pushHistory(std::move(group));
+}
+
+void Project::cancel() noexcept
+{
+	assert(inTransaction());
+	auto transaction = std::move(transaction_);
+	if (!transaction->updated) return;
+
+	auto prevCurrent = current();
+	current_ = current_.apply(history_.back().delta, true);
+	historyMemoryUsage_ -= history_.back().memoryUsage;
+	history_.pop_back();
+
+	if (hasMutationCallback()) emitMutation(std::make_shared<MutationInfo>(prevCurrent, current(), transaction->operations));
+}
+
+void Project::setHistoryBudget(size_t bytes) noexcept
+{
+	historyBudget_ = bytes;
+	if (!inTransaction()) trimHistory();
+}
+
+void Project::setResidentHistory(size_t entries) noexcept
+{
+	residentHistory_ = entries;
+	if (!inTransaction()) spillHistory();
+}
+
+void Project::pushHistory(history_group_t&& group) noexcept
+{
+	group.memoryUsage = memoryUsage(group);
+	historyMemoryUsage_ += group.memoryUsage;
+	history_.push_back(std::move(group));
+	spillHistory();
+	trimHistory();
+}
+
+void Project::clearRedoStack() noexcept
+{
+	for (auto&& group : redoStack_) historyMemoryUsage_ -= group.memoryUsage;
+	redoStack_.clear();
+}
+
+void Project::trimHistory() noexcept
+{
+	// The budget covers undo and redo, whichever end is furthest away from the current document goes first
+	while (historyMemoryUsage_ > historyBudget_ && (history_.size() > 1 || !redoStack_.empty()))
+	{
+		if (redoStack_.size() > history_.size() - 1)
+		{
+			historyMemoryUsage_ -= redoStack_.front().memoryUsage;
+			redoStack_.pop_front();
+			continue;
+		}
+
+		// The oldest entry can never be undone, so once the second oldest entry becomes the oldest its delta isn't needed anymore
+		auto& oldest = history_[1];
+		historyMemoryUsage_ -= history_[0].memoryUsage + oldest.memoryUsage;
+		oldest.delta = {};
+		oldest.operations = {};
+		if (oldest.spilled.size)
+		{
+			spillFile_->release(oldest.spilled);
+			oldest.spilled = {};
+			spilled_--;
+		}
+		oldest.memoryUsage = memoryUsage(oldest);
+		historyMemoryUsage_ += oldest.memoryUsage;
+		history_.pop_front();
+	}
+}
+
+void Project::spillHistory() noexcept
+{
+	while (history_.size() - 1 - spilled_ > residentHistory_)
+	{
+		auto& group = history_[1 + spilled_];
+		if (!spillFile_) spillFile_ = std::make_unique<MappedFile>();
+
+		std::ostringstream stream(std::ios::binary);
+		{
+			cereal::BinaryOutputArchive archive(stream);
+			archive(group.delta);
+			archive(group.operations);
+		}
+
+		// Without room on disk the entry stays in memory, the next push tries again
+		group.spilled = spillFile_->append(stream.str());
+		if (!group.spilled.size) return;
+
+		historyMemoryUsage_ -= group.memoryUsage;
+		group.delta = {};
+		group.operations = {};
+		group.memoryUsage = memoryUsage(group);
+		historyMemoryUsage_ += group.memoryUsage;
+		spilled_++;
+	}
+}
+
+bool Project::restoreHistory(history_group_t& group) noexcept
+{
+	if (!group.spilled.size) return true;
+
+	group.unreadable = !spillFile_->read(group.spilled, [&](std::istream& stream)
+	{
+		cereal::BinaryInputArchive archive(stream);
+		archive(group.delta);
+		archive(group.operations);
+	});
+	if (group.unreadable)
+	{
+		group.delta = {};
+		group.operations = {};
+		return false;
+	}
+
+	spillFile_->release(group.spilled);
+	group.spilled = {};
+	spilled_--;
+
+	historyMemoryUsage_ -= group.memoryUsage;
+	group.memoryUsage = memoryUsage(group);
+	historyMemoryUsage_ += group.memoryUsage;
+	return true;
+}
+
+void Project::replay(const Document::Delta& delta, bool inverse) noexcept
+{
+	// The history starts after the journal, there is nothing yet that the change could conflict with
+	assert(history_.size() == 1 && redoStack_.empty());
+	current_ = current_.apply(delta, inverse);
+}
+
+void Project::setMutationCallback(mutation_callback_fn fn, MutationInfo::Category categories, Dispatch dispatch) noexcept
+{
+	if (dispatch == Dispatch::Immediate)
+	{
+		mutationCallback_ = fn;
+		mutationCategories_ = categories;
+		return;
+	}
+
+	// Mutations that were already posted still go to the callback they were posted for
+	if (fn && !backgroundQueue_) backgroundQueue_ = std::make_unique<SerialQueue>();
+	backgroundCallback_ = fn;
+	backgroundCategories_ = categories;
+}
+
+void Project::waitForMutations() const noexcept
+{
+	if (backgroundQueue_) backgroundQueue_->wait();
 }
 
 void Project::emitMutationsComparedTo(const Document& d) const noexcept
 {
-	mutationCallback_(std::make_shared<MutationInfo>(d, current()));
+	emitMutation(std::make_shared<MutationInfo>(d, current()));
+}
+
+void Project::emitMutation(std::shared_ptr<MutationInfo> mutationInfo) const noexcept
+{
+	// Creating the MutationInfo is cheap, the change sets are only computed when the callback asks for them.
+	// Callbacks for all categories also hear about mutations that changed nothing, the undo history still grew.
+	auto wants = [&](MutationInfo::Category categories) { return categories == MutationInfo::Category::All || mutationInfo->touches(categories); };
+
+	// MutationInfo holds on to both documents, so it stays valid on another thread while the project moves on
+	if (backgroundCallback_ && wants(backgroundCategories_))
+	{
+		auto fn = backgroundCallback_;
+		backgroundQueue_->post([fn, mutationInfo]() { fn(mutationInfo); });
+	}
+	if (mutationCallback_ && wants(mutationCategories_)) mutationCallback_(mutationInfo);
 }
 
 ///
@@ -105,14 +345,22 @@ void Project::save(Archive& archive) const
 template<class Archive>
 void Project::load(Archive& archive)
 {
+	// Nothing changes until everything was read, so a load that throws leaves the project as it was
 	MutableNodePtr root;
 	archive(root);
-	root_ = root;
-
 	Document d;
 	archive(d);
-	history_ = { { "New project", { d } } };
+
+	root_ = root;
+	history_ = { { "New project", {}, {} } };
+	redoStack_.clear();
+	current_ = d;
+	historyMemoryUsage_ = 0;
+	spillFile_.reset();
+	spilled_ = 0;
 }
 
 template void Project::save<cereal::JSONOutputArchive>(cereal::JSONOutputArchive& archive) const;
 template void Project::load<cereal::JSONInputArchive>(cereal::JSONInputArchive& archive);
+template void Project::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Project::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
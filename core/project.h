@@ -1,6 +1,9 @@
 #pragma once
 #include "static.h"
 #include "document.h"
+#include "mapped_file.h"
+#include "mutation_info.h"
+#include "parallel.h"
 
 BEGIN_NAMESPACE(Core)
 
@@ -23,11 +26,29 @@ public:
 		}
 	};
 
-	using history_group_t = std::pair<std::string, Document>; // description + changes
-	using history_t = std::vector<history_group_t>;
-	using redohistory_t = std::stack<history_group_t>;
+	// Entries only hold what changed, undo and redo rebuild the documents from the current one
+	struct HistoryGroup
+	{
+		std::string description;
+		Document::Delta delta; // how the document of this entry is made from the one before it, and back
+		Document::operations_t operations; // the same, as a log for MutationInfo
+		size_t memoryUsage {};
+		MappedFile::Record spilled; // set while delta and operations are on disk
+		bool unreadable {}; // reading the entry back from disk failed, undo stops before it
+	};
+
+	using history_group_t = HistoryGroup;
+	using history_t = std::deque<history_group_t>;
+	using redohistory_t = std::deque<history_group_t>; // the next entry to redo at the back
 	using mutate_fn = std::function<void(Document::Builder&)>;
 	using mutation_callback_fn = std::function<void(std::shared_ptr<MutationInfo>)>;
+	using journal_callback_fn = std::function<void(const Document::Delta& delta, bool inverse)>;
+
+	// Undo history beyond this many bytes is dropped, oldest first
+	static const size_t DEFAULT_HISTORY_BUDGET = 512 * 1024 * 1024;
+
+	// Entries older than this many steps are written to a scratch file, and read back once undo reaches them
+	static const size_t DEFAULT_RESIDENT_HISTORY = 100;
 
 	Project();
 
@@ -38,21 +59,86 @@ public:
 	UndoState undoState() const noexcept;
 
 	const Document& current() const noexcept;
+
+	// Steps run one after the other on the same builder, until mutate returns current() doesn't include any of them
+	// A transaction that is still open is committed first, so the mutation gets an entry of its own after it
 	void mutate(mutate_fn fn, std::string description = "") noexcept;
 	void mutate(std::initializer_list<mutate_fn> fns, std::string description = "") noexcept;
 
-	void setMutationCallback(mutation_callback_fn fn) noexcept;
+	// Continuous edits such as dragging or scrubbing a value. Every update replaces the pending document
+	// and only reports what that update changed, commit leaves a single entry in the history.
+	void beginTransaction(std::string description = "") noexcept;
+	void update(mutate_fn fn) noexcept;
+	void commit() noexcept;
+	void cancel() noexcept;
+	bool inTransaction() const noexcept { return transaction_ != nullptr; }
+
+	// Estimate of the memory held by the undo and redo history, on top of the current document
+	size_t historyMemoryUsage() const noexcept { return historyMemoryUsage_; }
+	void setHistoryBudget(size_t bytes) noexcept;
+
+	size_t historyDiskUsage() const noexcept { return spillFile_ ? spillFile_->size() : 0; }
+	void setResidentHistory(size_t entries) noexcept;
+
+	enum class Dispatch
+	{
+		Immediate, // before the call that made the mutation returns, on the same thread
+		Background // later and in order on a thread of its own, current() may have moved on by then
+	};
+
+	// Unless categories is All, the callback only runs for mutations that touch one of the given categories.
+	// There is one callback per dispatch mode, so heavy listeners can run in the background next to the one for the GUI.
+	void setMutationCallback(mutation_callback_fn fn, MutationInfo::Category categories = MutationInfo::Category::All, Dispatch dispatch = Dispatch::Immediate) noexcept;
 	void emitMutationsComparedTo(const Document& d) const noexcept;
 
+	// Blocks until the background callback has seen every mutation so far
+	void waitForMutations() const noexcept;
+
+	// Runs with every change that is added to the history, undone or redone, after current() has changed.
+	// Updates of a transaction are left out, the transaction as a whole is reported when it is committed.
+	void setJournalCallback(journal_callback_fn fn) noexcept { journalCallback_ = fn; }
+
+	// Applies a journaled change to a project that was just loaded, it can't be undone
+	void replay(const Document::Delta& delta, bool inverse) noexcept;
+
 private:	
 	friend class cereal::access;
 	template<class Archive> void save(Archive& archive) const;
 	template<class Archive>	void load(Archive& archive);
 
+	struct Transaction
+	{
+		std::string description;
+		bool updated {}; // the pending document is on top of the history
+		Document::operations_t operations;
+		std::unordered_set<Uuid> mutated; // a node mutated over and over only needs to be logged once
+	};
+
+	void pushHistory(history_group_t&& group) noexcept;
+	void clearRedoStack() noexcept;
+	void trimHistory() noexcept;
+	void spillHistory() noexcept;
+	bool restoreHistory(history_group_t& group) noexcept;
+
 	history_t history_;
 	redohistory_t redoStack_;
+	Document current_; // document of the newest entry in the history
+	size_t historyMemoryUsage_ {};
+	size_t historyBudget_ { DEFAULT_HISTORY_BUDGET };
+	std::unique_ptr<MappedFile> spillFile_; // created once the history first outgrows residentHistory_
+	size_t residentHistory_ { DEFAULT_RESIDENT_HISTORY };
+	size_t spilled_ {}; // entries after the first one that are on disk, they are always the oldest
+	std::unique_ptr<Transaction> transaction_;
 	NodePtr root_;
 	mutation_callback_fn mutationCallback_;
+	MutationInfo::Category mutationCategories_ { MutationInfo::Category::All };
+	mutation_callback_fn backgroundCallback_;
+	MutationInfo::Category backgroundCategories_ { MutationInfo::Category::All };
+	std::unique_ptr<SerialQueue> backgroundQueue_; // created with the first background callback
+	journal_callback_fn journalCallback_;
+
+	bool hasMutationCallback() const noexcept { return mutationCallback_ || backgroundCallback_; }
+	void emitMutation(std::shared_ptr<MutationInfo> mutationInfo) const noexcept;
 };
 
 END_NAMESPACE(Core)
\ No newline at end of file
@@ -1,7 +1,16 @@
 #include "property.h"
+#include "bake_cache.h"
 #include "metadata.h"
 #include "factory.h"
-
+#include "interpolation.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <numeric>
+
+using Core::BakeCache;
 using Core::Property;
 using Core::PropertyMetadata;
 using Core::Factory;
@@ -10,15 +19,103 @@ using Core::HashValue;
 using Core::PropertyPtr;
 using Core::PropertyMetadataPtr;
 using Core::PropertyValue;
+using Core::Segment;
 using Builder = Property::Builder;
 
+namespace {
+
+// Baking costs an evaluation for every sample, so it only pays off for requests that use at least 1 / MIN_BAKE_USE of them
+const size_t MIN_BAKE_USE = 4;
+
+// No property takes up more than 1 / MAX_BAKE_SHARE of the budget, so a single one can't push out all others
+const size_t MAX_BAKE_SHARE = 8;
+
+// Values at every multiple of 1 / rate between the first and the last key
+template <typename T>
+struct Baked: BakeCache::Entry
+{
+	int rate;
+	int64_t first; // sample k is at frame k / rate
+	std::vector<T> values;
+
+	// Only frames that were sampled exactly, so the value is the same as evaluating the keys
+	const T* find(Frame frame) const noexcept
+	{
+		auto position = std::floor(frame * static_cast<Frame>(rate));
+		if (position != frame * static_cast<Frame>(rate)) return nullptr;
+
+		auto k = static_cast<int64_t>(position);
+		if (k < first || k - first >= static_cast<int64_t>(values.size()) || static_cast<Frame>(k) / static_cast<Frame>(rate) != frame) return nullptr;
+		return &values[static_cast<size_t>(k - first)];
+	}
+};
+
+}
+
 struct Property::Impl
 {
+	// Every key of a property has the same type, so the values are packed into one array of that type.
+	// The alternatives are in the same order as those of PropertyValue.
+	using values_t = eggs::variant<std::vector<int>, std::vector<double>, std::vector<glm::vec2>, std::vector<glm::vec3>, std::vector<std::string>>;
+
 	HashValue nodeType_;
 	HashValue propertyType_;
 	PropertyMetadataPtr metadata_;
-	keys_t keys_;
+	keys_t frames_; // sorted, with the value of each at the same index of values_
+	values_t values_;
 	bool animated_ {};
+
+	// Samples for dense evaluation, owned by the BakeCache. A copy is about to get other keys, so it starts without.
+	struct Bake
+	{
+		Bake() = default;
+		Bake(const Bake&) noexcept {}
+		Bake& operator=(const Bake&) noexcept { reset(); return *this; }
+		~Bake() { reset(); }
+
+		void reset() noexcept
+		{
+			if (auto entry = this->entry.lock()) BakeCache::instance().erase(*entry);
+			entry.reset();
+		}
+
+		std::mutex mutex;
+		std::weak_ptr<const BakeCache::Entry> entry;
+	};
+	mutable Bake bake_;
+
+	// Computed the first time they are asked for, a copy is about to get other keys so it starts without
+	struct Constants
+	{
+		Constants() = default;
+		Constants(const Constants&) noexcept {}
+		Constants& operator=(const Constants&) noexcept
+		{
+			computed = false;
+			intervals.clear();
+			return *this;
+		}
+
+		std::mutex mutex;
+		std::atomic<bool> computed { false };
+		intervals_t intervals;
+	};
+	mutable Constants constants_;
+
+	void computeConstants() const noexcept;
+
+	// Samples for evaluating count frames that are step apart, nullptr when they aren't worth baking
+	template <typename T>
+	std::shared_ptr<const Baked<T>> baked(Frame step, size_t count) const noexcept;
+
+	template <typename T>
+	std::vector<T>* values() noexcept { return values_.target<std::vector<T>>(); }
+	template <typename T>
+	const std::vector<T>* values() const noexcept { return values_.target<std::vector<T>>(); }
+
+	PropertyValue value(size_t index) const noexcept;
+	void set(Frame frame, PropertyValue&& value) noexcept;
+	void erase(Frame frame) noexcept;
 };
 
 Property::Property()
@@ -46,85 +143,418 @@ Property& Property::operator=(const Property& rhs)
 Property::Property(Property&& rhs) = default;
 Property& Property::operator=(Property&& rhs) = default;
 
-struct Interpolator
+namespace {
+
+size_t lowerBound(const Property::keys_t& frames, Frame frame) noexcept
+{
+	return static_cast<size_t>(std::lower_bound(cbegin(frames), cend(frames), frame) - cbegin(frames));
+}
+
+// Evaluates frameAt(t) for every t in [0, count) into out. Segments are looked up once for every run of frames that falls in them.
+template <typename T, typename FrameAt>
+void evaluateKeys(const Property::keys_t& frames, const std::vector<T>* values, const PropertyValue& defaultValue, size_t count, FrameAt frameAt, T* out) noexcept
 {
-	explicit Interpolator(float alpha, PropertyValue& p, PropertyValue& n, PropertyValue& pp, PropertyValue& nn)
-		: alpha(alpha)
-		, p_(p)
-		, n_(n)
-		, pp_(pp)
-		, nn_(nn)
-	{}
+	if (frames.empty())
+	{
+		assert(defaultValue.target<T>());
+		std::fill_n(out, count, *defaultValue.target<T>());
+		return;
+	}
 
-	float alpha;
-	PropertyValue& p_;
-	PropertyValue& n_;
-	PropertyValue& pp_;
-	PropertyValue& nn_;
+	assert(values);
+	if (!values) return;
 
-	template <typename T>
-	PropertyValue operator()(const T& _)
+	size_t next = 0;
+	for (size_t t = 0; t < count;)
+	{
+		auto frame = frameAt(t);
+		next = Core::seek(frames.data(), frames.size(), next, frame);
+
+		// Before the first key, and at or beyond the last one
+		if (!next || next == frames.size())
+		{
+			out[t++] = next ? values->back() : values->front();
+			continue;
+		}
+
+		auto prev = next - 1;
+		auto lower = frames[prev];
+		auto span = frames[next] - lower;
+		Segment<T> segment((*values)[prev], (*values)[next]);
+		do
+		{
+			out[t] = frame == lower ? (*values)[prev] : segment((frame - lower) / span);
+		}
+		while (++t < count && (frame = frameAt(t)) >= lower && frame < frames[next]);
+	}
+}
+
+}
+
+PropertyValue Property::Impl::value(size_t index) const noexcept
+{
+	return eggs::variants::apply<PropertyValue>([&](const auto& values) { return PropertyValue(values[index]); }, values_);
+}
+
+void Property::Impl::set(Frame frame, PropertyValue&& value) noexcept
+{
+	// The first key decides the type of the property
+	if (frames_.empty() && values_.which() != value.which())
 	{
-		T& p = *p_.target<T>();
-		T& n = *n_.target<T>();
-		T& pp = *pp_.target<T>();
-		T& nn = *nn_.target<T>();
-
-		float alpha2 = alpha * alpha;
-		auto a0 = (pp * -0.5f) + (p * 1.5f) - (n * 1.5f) + (nn * 0.5f);
-		auto a1 = pp - p * 2.5f + n * 2.0f - nn * 0.5f;
-		auto a2 = pp * -0.5f + n * 0.5f;
-		auto a3 = p;
-
-		return static_cast<T>(a0 * alpha * alpha2 + a1 * alpha2 + a2 * alpha + a3);
+		eggs::variants::apply([&](const auto& v) { values_ = std::vector<std::decay_t<decltype(v)>>(); }, value);
 	}
-};
 
-template <>
-inline PropertyValue Interpolator::operator()<std::string>(const std::string& _)
+	auto index = lowerBound(frames_, frame);
+	auto exists = index < frames_.size() && frames_[index] == frame;
+
+	eggs::variants::apply([&](auto& v)
+	{
+		auto values = this->values<std::decay_t<decltype(v)>>();
+		assert(values);
+		if (!values) return;
+
+		if (exists)
+		{
+			(*values)[index] = std::move(v);
+		}
+		else
+		{
+			frames_.insert(cbegin(frames_) + index, frame);
+			values->insert(values->begin() + index, std::move(v));
+		}
+	}, value);
+}
+
+void Property::Impl::erase(Frame frame) noexcept
 {
-	return p_;
+	auto index = lowerBound(frames_, frame);
+	if (index == frames_.size() || frames_[index] != frame) return;
+
+	frames_.erase(cbegin(frames_) + index);
+	eggs::variants::apply([&](auto& values) { values.erase(values.begin() + index); }, values_);
 }
 
 PropertyValue Property::getPropertyValue(Frame frame) const noexcept
 {
-	if (!impl_->keys_.size()) return impl_->metadata_->defaultValue();
+	auto& frames = impl_->frames_;
+	if (frames.empty()) return impl_->metadata_->defaultValue();
 
-	auto exactFrame = impl_->keys_.find(frame);
-	if (exactFrame != impl_->keys_.end()) return exactFrame->second;
+	auto next = static_cast<size_t>(std::upper_bound(cbegin(frames), cend(frames), frame) - cbegin(frames));
 
-	auto next = impl_->keys_.upper_bound(frame);
+	// Before the first key, and at or beyond the last one
+	if (!next) return impl_->value(0);
+	if (next == frames.size()) return impl_->value(next - 1);
 
-	// Beyond last item
-	if (next == impl_->keys_.cend())
+	auto prev = next - 1;
+	if (frames[prev] == frame) return impl_->value(prev);
+
+	auto alpha = (static_cast<float>(frame) - static_cast<float>(frames[prev])) / (static_cast<float>(frames[next]) - static_cast<float>(frames[prev]));
+	return eggs::variants::apply<PropertyValue>([&](const auto& values)
+	{
+		using T = typename std::decay_t<decltype(values)>::value_type;
+		return PropertyValue(Segment<T>(values[prev], values[next])(alpha));
+	}, impl_->values_);
+}
+
+template <typename T>
+void Property::evaluate(const Frame* frames, size_t count, T* out) const noexcept
+{
+	evaluateKeys(impl_->frames_, impl_->values<T>(), impl_->metadata_->defaultValue(), count, [&](size_t t) { return frames[t]; }, out);
+}
+
+template <typename T>
+std::shared_ptr<const Baked<T>> Property::Impl::baked(Frame step, size_t count) const noexcept
+{
+	// Strings aren't interpolated, and a single key is already constant
+	if (std::is_same<T, std::string>::value || frames_.size() < 2) return nullptr;
+
+	// Only worth it when every frame lands on a sample
+	auto& cache = BakeCache::instance();
+	auto rate = cache.sampleRate();
+	auto stride = step * static_cast<Frame>(rate);
+	if (stride < 1 || std::floor(stride) != stride) return nullptr;
+
+	std::lock_guard<std::mutex> lock(bake_.mutex);
+	auto result = std::static_pointer_cast<const Baked<T>>(bake_.entry.lock());
+	if (result && result->rate == rate)
 	{
-		--next;
-		return next->second;
+		cache.touch(*result);
+		return result;
+	}
+	bake_.reset();
+
+	auto first = static_cast<int64_t>(std::ceil(frames_.front() * static_cast<Frame>(rate)));
+	auto last = static_cast<int64_t>(std::floor(frames_.back() * static_cast<Frame>(rate)));
+	auto samples = static_cast<size_t>(std::max<int64_t>(last - first + 1, 0));
+	if (count < samples / MIN_BAKE_USE || samples * sizeof(T) > cache.budget() / MAX_BAKE_SHARE) return nullptr;
+
+	auto baked = std::make_shared<Baked<T>>();
+	baked->rate = rate;
+	baked->first = first;
+	baked->values.resize(samples);
+	baked->memoryUsage = sizeof(Baked<T>) + samples * sizeof(T);
+	evaluateKeys(frames_, values<T>(), metadata_->defaultValue(), samples, [&](size_t t) { return static_cast<Frame>(first + static_cast<int64_t>(t)) / static_cast<Frame>(rate); }, baked->values.data());
+
+	bake_.entry = baked;
+	cache.insert(baked);
+	return baked;
+}
+
+template <typename T>
+void Property::evaluate(Frame start, Frame step, size_t count, T* out) const noexcept
+{
+	auto frameAt = [&](size_t t) { return start + static_cast<Frame>(t) * step; };
+	auto baked = impl_->baked<T>(step, count);
+	if (!baked)
+	{
+		evaluateKeys(impl_->frames_, impl_->values<T>(), impl_->metadata_->defaultValue(), count, frameAt, out);
+		return;
 	}
 
-	// Before first
-	if (next == impl_->keys_.cbegin())
+	// Frames outside of the samples, or that didn't land on one after all, are evaluated from the keys
+	Cursor<T> cursor(*this);
+	for (size_t t = 0; t < count; t++)
 	{
-		return next->second;
+		auto frame = frameAt(t);
+		auto value = baked->find(frame);
+		out[t] = value ? *value : cursor(frame);
 	}
+}
 
-	auto prev = next--;
-	auto prevprev = prev--;
-	auto nextnext = next++;
+template <typename T>
+struct Property::Cursor<T>::State
+{
+	const keys_t& frames;
+	const std::vector<T>* values;
+	T defaultValue;
+
+	// The frames [lower, upper) all evaluate with segment, or to constant when it is set
+	Frame lower { std::numeric_limits<Frame>::infinity() };
+	Frame upper { -std::numeric_limits<Frame>::infinity() };
+	size_t next {};
+	const T* constant {};
+	Segment<T> segment;
+
+	void seek(Frame frame) noexcept
+	{
+		constexpr auto infinity = std::numeric_limits<Frame>::infinity();
+		if (frames.empty())
+		{
+			lower = -infinity;
+			upper = infinity;
+			constant = &defaultValue;
+			return;
+		}
 
-	auto alpha = (static_cast<float>(frame) - static_cast<float>(prev->first)) / (static_cast<float>(next->first) - static_cast<float>(prev->first));
+		next = Core::seek(frames.data(), frames.size(), next, frame);
+		lower = next ? frames[next - 1] : -infinity;
+		upper = next < frames.size() ? frames[next] : infinity;
 
-	Interpolator interpolator(alpha, prev->second, next->second, prevprev->second, nextnext->second);
-	return eggs::variants::apply<PropertyValue>(interpolator, prev->second);
+		// Before the first key, and at or beyond the last one
+		if (!next || next == frames.size())
+		{
+			constant = next ? &values->back() : &values->front();
+			return;
+		}
+
+		constant = nullptr;
+		segment = Segment<T>((*values)[next - 1], (*values)[next]);
+	}
+};
+
+template <typename T>
+Property::Cursor<T>::Cursor(const Property& property) noexcept
+	: state_(std::make_unique<State>(State { property.impl_->frames_, property.impl_->values<T>(), *property.impl_->metadata_->defaultValue().template target<T>() }))
+{
+	assert(state_->frames.empty() || state_->values);
+}
+
+template <typename T>
+Property::Cursor<T>::~Cursor() = default;
+
+template <typename T>
+Property::Cursor<T>::Cursor(Cursor&& rhs) noexcept = default;
+
+template <typename T>
+Property::Cursor<T>& Property::Cursor<T>::operator=(Cursor&& rhs) noexcept = default;
+
+template <typename T>
+T Property::Cursor<T>::operator()(Frame frame) noexcept
+{
+	auto& state = *state_;
+	if (!(frame >= state.lower && frame < state.upper)) state.seek(frame);
+
+	if (state.constant) return *state.constant;
+	return frame == state.lower ? (*state.values)[state.next - 1] : state.segment((frame - state.lower) / (state.upper - state.lower));
 }
 
-std::set<Frame> Property::keys() const noexcept
+template class Property::Cursor<int>;
+template class Property::Cursor<double>;
+template class Property::Cursor<glm::vec2>;
+template class Property::Cursor<glm::vec3>;
+template class Property::Cursor<std::string>;
+
+template void Property::evaluate<int>(const Frame* frames, size_t count, int* out) const noexcept;
+template void Property::evaluate<double>(const Frame* frames, size_t count, double* out) const noexcept;
+template void Property::evaluate<glm::vec2>(const Frame* frames, size_t count, glm::vec2* out) const noexcept;
+template void Property::evaluate<glm::vec3>(const Frame* frames, size_t count, glm::vec3* out) const noexcept;
+template void Property::evaluate<std::string>(const Frame* frames, size_t count, std::string* out) const noexcept;
+template void Property::evaluate<int>(Frame start, Frame step, size_t count, int* out) const noexcept;
+template void Property::evaluate<double>(Frame start, Frame step, size_t count, double* out) const noexcept;
+template void Property::evaluate<glm::vec2>(Frame start, Frame step, size_t count, glm::vec2* out) const noexcept;
+template void Property::evaluate<glm::vec3>(Frame start, Frame step, size_t count, glm::vec3* out) const noexcept;
+template void Property::evaluate<std::string>(Frame start, Frame step, size_t count, std::string* out) const noexcept;
+
+const Property::keys_t& Property::keys() const noexcept
 {
-	std::set<Frame> result;
-	for (auto&& kvp : impl_->keys_) result.insert(kvp.first);
+	return impl_->frames_;
+}
+
+namespace {
+
+// Whether every frame between the keys at index and index + 1 has the value of the first key
+template <typename T>
+bool holds(const std::vector<T>& values, size_t index) noexcept
+{
+	using coefficient_t = typename Segment<T>::coefficient_t;
+	Segment<T> segment(values[index], values[index + 1]);
+	return segment.a0 == coefficient_t(0) && segment.a1 == coefficient_t(0) && segment.a2 == coefficient_t(0) && static_cast<T>(segment.a3) == values[index];
+}
+
+bool holds(const std::vector<std::string>& values, size_t index) noexcept
+{
+	return true;
+}
+
+}
+
+void Property::Impl::computeConstants() const noexcept
+{
+	std::lock_guard<std::mutex> lock(constants_.mutex);
+	if (constants_.computed) return;
+
+	constexpr auto infinity = std::numeric_limits<Frame>::infinity();
+	auto& intervals = constants_.intervals;
+	auto add = [&](Frame first, Frame last) { if (first < last) intervals.emplace_back(first, last); };
+
+	// A run starts at a key, or before all of them, and goes on until a segment moves or the value jumps at a key
+	auto start = -infinity;
+	if (!frames_.empty())
+	{
+		eggs::variants::apply([&](const auto& values)
+		{
+			for (size_t t = 0; t + 1 < frames_.size(); t++)
+			{
+				if (!holds(values, t))
+				{
+					add(start, frames_[t]);
+					start = frames_[t + 1];
+				}
+				else if (values[t] != values[t + 1])
+				{
+					add(start, std::nextafter(frames_[t + 1], -infinity));
+					start = frames_[t + 1];
+				}
+			}
+		}, values_);
+	}
+	add(start, infinity);
+
+	constants_.computed = true;
+}
+
+const Property::intervals_t& Property::constantIntervals() const noexcept
+{
+	if (!impl_->constants_.computed) impl_->computeConstants();
+	return impl_->constants_.intervals;
+}
+
+bool Property::isConstant(Frame first, Frame last) const noexcept
+{
+	assert(first <= last);
+	if (first == last) return true;
+	auto& intervals = constantIntervals();
+
+	// The last interval that starts at or before first is the only one that can hold all of [first, last]
+	auto it = std::upper_bound(cbegin(intervals), cend(intervals), first, [](Frame frame, const interval_t& interval) { return frame < interval.first; });
+	return it != cbegin(intervals) && std::prev(it)->second >= last;
+}
+
+Property::KeyChanges Property::diffKeys(const Property& prev, const Property& cur) noexcept
+{
+	KeyChanges result;
+
+	auto& prevImpl = *prev.impl_;
+	auto& curImpl = *cur.impl_;
+	if (&prevImpl == &curImpl) return result;
+
+	auto& prevFrames = prevImpl.frames_;
+	auto& curFrames = curImpl.frames_;
+	auto sameValue = [&](size_t prevIndex, size_t curIndex)
+	{
+		return eggs::variants::apply<bool>([&](const auto& values)
+		{
+			auto curValues = curImpl.values_.target<std::decay_t<decltype(values)>>();
+			return curValues && (*curValues)[curIndex] == values[prevIndex];
+		}, prevImpl.values_);
+	};
+
+	// Both are sorted, so walking them side by side finds every difference in one pass
+	std::vector<size_t> removed, added;
+	size_t prevIndex = 0;
+	size_t curIndex = 0;
+	while (prevIndex < prevFrames.size() || curIndex < curFrames.size())
+	{
+		if (curIndex == curFrames.size() || (prevIndex < prevFrames.size() && prevFrames[prevIndex] < curFrames[curIndex]))
+		{
+			removed.emplace_back(prevIndex++);
+		}
+		else if (prevIndex == prevFrames.size() || curFrames[curIndex] < prevFrames[prevIndex])
+		{
+			added.emplace_back(curIndex++);
+		}
+		else
+		{
+			if (!sameValue(prevIndex, curIndex)) result.changed.emplace_back(curFrames[curIndex]);
+			++prevIndex;
+			++curIndex;
+		}
+	}
+
+	// Pair up removed and added keys with the same value in order, those are keys that were dragged to another frame
+	auto removedIt = cbegin(removed);
+	auto addedIt = cbegin(added);
+	while (removedIt != cend(removed) && addedIt != cend(added))
+	{
+		if (sameValue(*removedIt, *addedIt))
+		{
+			result.moved.emplace_back(prevFrames[*removedIt++], curFrames[*addedIt++]);
+		}
+		else if (prevFrames[*removedIt] < curFrames[*addedIt])
+		{
+			result.removed.emplace_back(prevFrames[*removedIt++]);
+		}
+		else
+		{
+			result.added.emplace_back(curFrames[*addedIt++]);
+		}
+	}
+	for (; removedIt != cend(removed); ++removedIt) result.removed.emplace_back(prevFrames[*removedIt]);
+	for (; addedIt != cend(added); ++addedIt) result.added.emplace_back(curFrames[*addedIt]);
+
 	return result;
 }
 
+size_t Property::memoryUsage() const noexcept
+{
+	size_t values = 0;
+	if (impl_->values_.which() != eggs::variant_npos)
+	{
+		values = eggs::variants::apply<size_t>([](const auto& v) { return v.capacity() * sizeof(typename std::decay_t<decltype(v)>::value_type); }, impl_->values_);
+	}
+	return sizeof(Property) + sizeof(Impl) + impl_->frames_.capacity() * sizeof(Frame) + values;
+}
+
 const PropertyMetadata& Property::metadata() const noexcept
 {
 	return *impl_->metadata_;
@@ -202,14 +632,68 @@ Property& Property::operator=(Builder&& rhs)
 
 void Builder::set(Frame frame, PropertyValue value) noexcept
 {
-	impl_->keys_[frame] = value;
+	impl_->set(frame, std::move(value));
 }
 
 void Builder::erase(Frame frame) noexcept
 {
-	impl_->keys_.erase(frame);
+	impl_->erase(frame);
 }
 
+template <typename T>
+void Builder::set(const std::vector<Frame>& frames, const std::vector<T>& values) noexcept
+{
+	assert(frames.size() == values.size());
+	if (frames.empty()) return;
+
+	auto& impl = *impl_;
+	if (impl.frames_.empty()) impl.values_ = std::vector<T>();
+	auto existing = impl.values<T>();
+	assert(existing);
+	if (!existing) return;
+
+	// Equal frames keep their order, so the last one of them can win
+	std::vector<size_t> order(frames.size());
+	std::iota(begin(order), end(order), 0);
+	std::stable_sort(begin(order), end(order), [&](size_t lhs, size_t rhs) { return frames[lhs] < frames[rhs]; });
+
+	keys_t mergedFrames;
+	std::vector<T> mergedValues;
+	mergedFrames.reserve(impl.frames_.size() + frames.size());
+	mergedValues.reserve(impl.frames_.size() + frames.size());
+
+	size_t index = 0;
+	auto keep = [&](size_t end)
+	{
+		for (; index < end; index++)
+		{
+			mergedFrames.emplace_back(impl.frames_[index]);
+			mergedValues.emplace_back(std::move((*existing)[index]));
+		}
+	};
+
+	for (size_t t = 0; t < order.size(); t++)
+	{
+		auto frame = frames[order[t]];
+		if (t + 1 < order.size() && frames[order[t + 1]] == frame) continue;
+
+		keep(lowerBound(impl.frames_, frame));
+		if (index < impl.frames_.size() && impl.frames_[index] == frame) index++;
+		mergedFrames.emplace_back(frame);
+		mergedValues.emplace_back(values[order[t]]);
+	}
+	keep(impl.frames_.size());
+
+	impl.frames_ = std::move(mergedFrames);
+	impl.values_ = std::move(mergedValues);
+}
+
+template void Builder::set<int>(const std::vector<Frame>& frames, const std::vector<int>& values) noexcept;
+template void Builder::set<double>(const std::vector<Frame>& frames, const std::vector<double>& values) noexcept;
+template void Builder::set<glm::vec2>(const std::vector<Frame>& frames, const std::vector<glm::vec2>& values) noexcept;
+template void Builder::set<glm::vec3>(const std::vector<Frame>& frames, const std::vector<glm::vec3>& values) noexcept;
+template void Builder::set<std::string>(const std::vector<Frame>& frames, const std::vector<std::string>& values) noexcept;
+
 void Builder::setAnimated(bool animated) noexcept
 {
 	impl_->animated_ = animated;
@@ -261,11 +745,12 @@ void Property::save(Archive& archive) const
 	archive(impl_->nodeType_);
 	archive(impl_->propertyType_);
 
-	archive(impl_->keys_.size());
-	for (auto&& kvp : impl_->keys_)
+	archive(impl_->frames_.size());
+	for (size_t t = 0; t < impl_->frames_.size(); t++)
 	{
-		archive(kvp.first);
-		archive(kvp.second);
+		auto value = impl_->value(t);
+		archive(impl_->frames_[t]);
+		archive(value);
 	}
 
 	archive(impl_->animated_);
@@ -278,15 +763,17 @@ void Property::load(Archive& archive)
 	archive(impl_->propertyType_);
 	setMetadata(impl_->nodeType_, impl_->propertyType_);
 
+	// Keys were saved in order, so each one is appended
 	size_t size;
 	archive(size);
+	impl_->frames_.reserve(size);
 	for (size_t t = 0; t < size; t++)
 	{
 		Frame frame;
 		PropertyValue value = defaultValue();
 		archive(frame);
 		archive(value);
-		impl_->keys_[frame] = value;
+		impl_->set(frame, std::move(value));
 	}
 
 	archive(impl_->animated_);
@@ -294,3 +781,5 @@ void Property::load(Archive& archive)
 
 template void Property::save<cereal::JSONOutputArchive>(cereal::JSONOutputArchive& archive) const;
 template void Property::load<cereal::JSONInputArchive>(cereal::JSONInputArchive& archive);
+template void Property::save<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive) const;
+template void Property::load<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
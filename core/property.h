@@ -8,7 +8,20 @@ class PropertyMetadata;
 class Property
 {
 public:
-	using keys_t = std::map<Frame, PropertyValue>;
+	using keys_t = std::vector<Frame>;
+	using interval_t = std::pair<Frame, Frame>; // first and last frame, both included
+	using intervals_t = std::vector<interval_t>;
+
+	// How the keys of one version of a property turned into those of another, every list is in frame order
+	struct KeyChanges
+	{
+		std::vector<Frame> added;
+		std::vector<Frame> removed;
+		std::vector<std::pair<Frame, Frame>> moved; // from, to; a removed key whose value reappeared at another frame
+		std::vector<Frame> changed; // same frame, different value
+
+		bool empty() const noexcept { return added.empty() && removed.empty() && moved.empty() && changed.empty(); }
+	};
 
 private:
 	struct Impl;
@@ -36,9 +49,14 @@ public:
 		Builder(Builder&& rhs);
 		Builder& operator=(Builder&& rhs);
 
+		// Keys are kept sorted by frame, adding them in order only appends
 		void set(Frame frame, PropertyValue value) noexcept;
 		void erase(Frame frame) noexcept;
 
+		// Sets many keys in one pass over the existing ones, a later frame in the list wins over an earlier equal one
+		template <typename T>
+		void set(const std::vector<Frame>& frames, const std::vector<T>& values) noexcept;
+
 		void setAnimated(bool animated) noexcept;
 
 	private:
@@ -56,7 +74,50 @@ public:
 	}
 
 	PropertyValue getPropertyValue(Frame frame) const noexcept;
-	std::set<Frame> keys() const noexcept;
+
+	// The same values getPropertyValue returns for each of count frames, T has to be the type of the property.
+	// Frames in increasing order are evaluated in a single walk over the keys.
+	template <typename T>
+	void evaluate(const Frame* frames, size_t count, T* out) const noexcept;
+
+	// Frame t is start + t * step. Requests that cover a good part of the keys bake them into samples in the BakeCache.
+	template <typename T>
+	void evaluate(Frame start, Frame step, size_t count, T* out) const noexcept;
+
+	// Evaluates frames that mostly come in increasing order, as during playback. The segment of the last frame is kept,
+	// so another frame in it only costs the interpolation. The property has to outlive the cursor.
+	template <typename T>
+	class Cursor
+	{
+		struct State;
+
+	public:
+		explicit Cursor(const Property& property) noexcept;
+		~Cursor();
+
+		Cursor(Cursor&& rhs) noexcept;
+		Cursor& operator=(Cursor&& rhs) noexcept;
+
+		// The same value as get<T>(frame)
+		T operator()(Frame frame) noexcept;
+
+	private:
+		std::unique_ptr<State> state_;
+	};
+	const keys_t& keys() const noexcept;
+
+	// The spans over which the value doesn't change, in frame order and computed once per property.
+	// Holding still before the first or after the last key makes a span that starts or ends at infinity.
+	const intervals_t& constantIntervals() const noexcept;
+
+	// Whether every frame in [first, last] has the same value
+	bool isConstant(Frame first, Frame last) const noexcept;
+
+	// Linear in the number of keys of both properties
+	static KeyChanges diffKeys(const Property& prev, const Property& cur) noexcept;
+
+	// Estimate of the bytes this property takes up
+	size_t memoryUsage() const noexcept;
 
 	const PropertyMetadata& metadata() const noexcept;
 	bool samePropertyHash(const PropertyPtr other) const noexcept;
@@ -86,6 +147,9 @@ struct property_eq_hash
 	explicit property_eq_hash(HashValue nodeType, HashValue propertyType): nodeType_(nodeType), propertyType_(propertyType) { }
 	explicit property_eq_hash(PropertyPtr other): nodeType_(other->nodeType()), propertyType_(other->propertyType()) { }
 	bool operator()(PropertyPtr c1) const { return c1->samePropertyHash(nodeType_, propertyType_); }
+
+	// Equal for every property this matches
+	HashValue key() const { return nodeType_ ^ (propertyType_ + 0x9e3779b97f4a7c15ull + (nodeType_ << 6) + (nodeType_ >> 2)); }
 private:
 	HashValue nodeType_;
 	HashValue propertyType_;
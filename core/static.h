@@ -12,15 +12,17 @@
 #include <iostream>
 #include <vector>
 #include <stack>
+#include <deque>
 #include <eggs/variant.hpp>
-#include <tree/tree.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <cereal/archives/binary.hpp>
 #include <cereal/archives/json.hpp>
 #include <cereal/types/map.hpp>
 #include <cereal/types/utility.hpp>
 #include <cereal/types/unordered_set.hpp>
 #include <cereal/types/memory.hpp>
+#include <cereal/types/string.hpp>
 #include <cereal/types/tuple.hpp>
 #include <cereal/types/vector.hpp>
 
@@ -66,6 +68,7 @@ namespace Core
 	class Document;
 	struct MutationInfo;
 
-	using tree_t = tree<NodePtr>;
+	class NodeTree;
+	using tree_t = NodeTree;
 	using visibility_t = std::pair<Frame, Frame>;
 };
\ No newline at end of file
@@ -38,11 +38,22 @@ inline T prop(const Node& node, const char* propertyTitle, Frame frame)
 
 inline std::shared_ptr<const Node> findNode(Project& project, std::string nodeTitle)
 {
-	auto result = std::find_if(cbegin(project.current().nodes()), cend(project.current().nodes()), [nodeTitle](auto& node)
+	auto result = std::find_if(std::cbegin(project.current().nodes()), std::cend(project.current().nodes()), [nodeTitle](auto& node)
 	{
 		return prop<std::string>(*node, "$Title", 0) == nodeTitle;
 	});
-	if (result == cend(project.current().nodes())) return std::shared_ptr<const Node>();
+	if (result == std::cend(project.current().nodes())) return std::shared_ptr<const Node>();
+	return *result;
+}
+
+// Same, in a document that is still being built
+inline std::shared_ptr<const Node> findNode(const Document::Builder& builder, std::string nodeTitle)
+{
+	auto result = std::find_if(std::cbegin(builder.nodes()), std::cend(builder.nodes()), [nodeTitle](auto& node)
+	{
+		return prop<std::string>(*node, "$Title", 0) == nodeTitle;
+	});
+	if (result == std::cend(builder.nodes())) return std::shared_ptr<const Node>();
 	return *result;
 }
 
@@ -151,5 +151,7 @@ namespace Core {
 
 	template void Uuid::serialize<cereal::JSONOutputArchive>(cereal::JSONOutputArchive& archive);
 	template void Uuid::serialize<cereal::JSONInputArchive>(cereal::JSONInputArchive& archive);
+	template void Uuid::serialize<cereal::BinaryOutputArchive>(cereal::BinaryOutputArchive& archive);
+	template void Uuid::serialize<cereal::BinaryInputArchive>(cereal::BinaryInputArchive& archive);
 
 } // ::Core
\ No newline at end of file
@@ -21,6 +21,10 @@ Application::Application(int argc, char *argv[])
 	installEventFilter(this);
 	registerModules();
 	setup();
+
+	// Pick up an untitled project where a session that never saved it left off
+	restoreAutosave();
+	startAutosave();
 }
 
 void Application::registerModules()
@@ -104,13 +108,21 @@ void Application::removeFocusActions(QWidget* widget)
 
 void Application::connectActions()
 {
-	connect(globalActions_->newFile, &QAction::triggered, this, &Application::setup);
+	connect(globalActions_->newFile, &QAction::triggered, this, &Application::newFile);
 	connect(globalActions_->openFile, &QAction::triggered, this, &Application::openFile);
 	connect(globalActions_->saveFileAs, &QAction::triggered, this, &Application::saveFileAs);
 	connect(globalActions_->exit, &QAction::triggered, this, &Application::quit);
 
-	connect(globalActions_->undo, &QAction::triggered, this, [&]() { project().undo(); });
-	connect(globalActions_->redo, &QAction::triggered, this, [&]() { project().redo(); });
+	// An edit that is still going on becomes the entry that gets undone
+	connect(globalActions_->undo, &QAction::triggered, this, [&]()
+	{
+		if (project().inTransaction()) project().commit();
+		if (project().undoState().canUndo) project().undo();
+
+		// Undo does nothing when history that was written to disk can't be read back
+		globalActions_->undo->setEnabled(project().undoState().canUndo);
+	});
+	connect(globalActions_->redo, &QAction::triggered, this, [&]() { if (project().inTransaction()) project().commit(); if (project().undoState().canRedo) project().redo(); });
 
 	connect(this, &Application::projectMutated, this, [&](auto mutationInfo)
 	{
@@ -144,6 +156,8 @@ void Application::setup()
 	while (createdFocusActions_.size()) removeFocusActions(begin(createdFocusActions_)->first);
 	prevFocus_ = nullptr;
 
+	// Finishes writing the journal of the previous project before anything can read it
+	journal_.reset();
 	project_ = Project();
 	mainWindow_ = new QMainWindow();
 	mainWindow_->menuBar()->setNativeMenuBar(false);
@@ -163,6 +177,43 @@ void Application::setup()
 	emit projectChanged();
 }
 
+std::string Application::autosavePath() const
+{
+	// Projects that were never saved share one autosave
+	auto path = filename_.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/untitled" : filename_;
+	return QFile::encodeName(path).toStdString();
+}
+
+void Application::startAutosave()
+{
+	QDir().mkpath(QFileInfo(QFile::decodeName(autosavePath().c_str())).absolutePath());
+
+	journal_ = std::make_unique<Core::Journal>(autosavePath());
+	journal_->snapshot(project_.root(), project_.current());
+
+	project_.setJournalCallback([&](auto& delta, bool inverse)
+	{
+		journal_->append(delta, inverse);
+		if (journal_->needsSnapshot()) journal_->snapshot(project_.root(), project_.current());
+	});
+}
+
+bool Application::restoreAutosave()
+{
+	auto emptyDocument = project_.current();
+	if (!Core::Journal::restore(autosavePath(), project_)) return false;
+
+	project_.emitMutationsComparedTo(emptyDocument);
+	return true;
+}
+
+void Application::newFile()
+{
+	setup();
+	filename_.clear();
+	startAutosave();
+}
+
 void Application::openFile()
 {
 	auto filename = QFileDialog::getOpenFileName(nullptr, tr("Open project"), QString(), tr("Project files (*.json)"));
@@ -186,9 +237,18 @@ void Application::load(QString filename)
 	QFile file(filename);
 	if (!file.open(QFile::ReadOnly)) return;
 
-	QString contents = file.readAll();
-
 	setup();
+	filename_ = filename;
+
+	// Changes that were journaled after the file was last saved weren't saved yet
+	QFileInfo journal(filename + ".journal");
+	if (journal.exists() && journal.lastModified() >= QFileInfo(filename).lastModified() && restoreAutosave())
+	{
+		startAutosave();
+		return;
+	}
+
+	QString contents = file.readAll();
 	auto emptyDocument = project_.current();
 
 	{
@@ -200,6 +260,7 @@ void Application::load(QString filename)
 	}
 
 	project_.emitMutationsComparedTo(emptyDocument);
+	startAutosave();
 }
 
 void Application::save(QString filename)
@@ -211,11 +272,18 @@ void Application::save(QString filename)
 	}
 
 	QFile file(filename);
-	if (file.open(QFile::WriteOnly | QFile::Truncate))
+	if (!file.open(QFile::WriteOnly | QFile::Truncate)) return;
+
 	{
 		QTextStream stream(&file);
 		stream << s.str().c_str();
 	}
+
+	// The file holds everything now, the autosave starts over from it
+	journal_.reset();
+	Core::Journal::remove(autosavePath());
+	filename_ = filename;
+	startAutosave();
 }
 
 bool Application::eventFilter(QObject* object, QEvent* event)
@@ -1,5 +1,6 @@
 #pragma once
 #include "static.h"
+#include <core/journal.h>
 #include <core/project.h>
 
 #include "modules/metadata.h"
@@ -35,12 +36,20 @@ private:
 	void load(QString filename);
 	void save(QString filename);
 
+	// Every committed change is appended to a journal next to the project, which is replayed after a crash
+	std::string autosavePath() const;
+	void startAutosave();
+	bool restoreAutosave();
+
+	void newFile();
 	void openFile();
 	void saveFileAs();
 
 	bool eventFilter(QObject* object, QEvent* event);
 
 	Core::Project project_;
+	QString filename_;
+	std::unique_ptr<Core::Journal> journal_;
 	QMainWindow* mainWindow_;
 	std::shared_ptr<Actions> globalActions_;
 
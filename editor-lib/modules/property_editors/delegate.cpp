@@ -12,4 +12,26 @@ Delegate::Delegate(QObject* parent)
 	factory->registerEditor(QVariant::Vector3D, editorVec3);
 
 	setItemEditorFactory(factory);
+}
+
+void Delegate::setEditorData(QWidget* editor, const QModelIndex& index) const
+{
+	// Loading the value of the model is not an edit, only changes made after it are handed back
+	{
+		QSignalBlocker blocker(editor);
+		QStyledItemDelegate::setEditorData(editor, index);
+	}
+
+	// Hand every change to the model while editing, so scrubbing a value updates the document live
+	auto userProperty = editor->metaObject()->userProperty();
+	if (userProperty.hasNotifySignal())
+	{
+		auto slot = metaObject()->method(metaObject()->indexOfSlot("commitEditor()"));
+		connect(editor, userProperty.notifySignal(), this, slot, Qt::UniqueConnection);
+	}
+}
+
+void Delegate::commitEditor()
+{
+	emit commitData(qobject_cast<QWidget*>(sender()));
 }
\ No newline at end of file
@@ -9,6 +9,11 @@ class Delegate: public QStyledItemDelegate
 		
 public:
 	Delegate(QObject* parent);
+
+	void setEditorData(QWidget* editor, const QModelIndex& index) const override;
+
+private slots:
+	void commitEditor();
 };
 
 END_NAMESPACE(Editor) END_NAMESPACE(Modules) END_NAMESPACE(PropertyEditors)
@@ -35,9 +35,9 @@ EditorVec3::EditorVec3(QWidget *parent)
 	z_->installEventFilter(this);
 }
 
-void EditorVec3::xChanged(double d) { value_.setX(d); }
-void EditorVec3::yChanged(double d) { value_.setY(d); }
-void EditorVec3::zChanged(double d) { value_.setZ(d); }
+void EditorVec3::xChanged(double d) { if (value_.x() != d) { value_.setX(d); emit valueChanged(value_); } }
+void EditorVec3::yChanged(double d) { if (value_.y() != d) { value_.setY(d); emit valueChanged(value_); } }
+void EditorVec3::zChanged(double d) { if (value_.z() != d) { value_.setZ(d); emit valueChanged(value_); } }
 
 void EditorVec3::setValue(const QVector3D& value)
 {
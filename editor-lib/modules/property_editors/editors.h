@@ -6,7 +6,7 @@ BEGIN_NAMESPACE(Editor) BEGIN_NAMESPACE(Modules) BEGIN_NAMESPACE(PropertyEditors
 class EditorVec3: public QWidget
 {
 	Q_OBJECT
-	Q_PROPERTY(QVector3D value READ value WRITE setValue USER true)
+	Q_PROPERTY(QVector3D value READ value WRITE setValue NOTIFY valueChanged USER true)
 
 public:
 	explicit EditorVec3(QWidget* parent);
@@ -14,6 +14,9 @@ public:
 	void setValue(const QVector3D& value);
 	QVector3D value() const { return value_; }
 
+signals:
+	void valueChanged(const QVector3D& value);
+
 private slots:
 	void xChanged(double d);
 	void yChanged(double d);
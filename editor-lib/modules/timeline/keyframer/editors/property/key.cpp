@@ -21,6 +21,13 @@ void Key::setFrame(Frame frame)
 	move(frame_ - (width() / 2), 0);
 }
 
+void Key::reset(Frame frame, PropertyValue value)
+{
+	originalFrame_ = frame;
+	value_ = value;
+	setFrame(frame);
+}
+
 void Key::paintEvent(QPaintEvent* event)
 {
 	QPainter painter(this);
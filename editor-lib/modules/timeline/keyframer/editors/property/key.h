@@ -12,6 +12,9 @@ public:
 	Key(Core::Frame frame, Core::PropertyValue value, RowEditor* parent);
 
 	void setFrame(Core::Frame frame);
+
+	// Points the key at a new version of the keyframe it shows, after the property changed
+	void reset(Core::Frame frame, Core::PropertyValue value);
 	Core::Frame frame() const { return frame_; }
 	Core::Frame originalFrame() const { return originalFrame_; }
 
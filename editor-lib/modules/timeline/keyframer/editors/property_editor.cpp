@@ -28,7 +28,7 @@ PropertyEditor::PropertyEditor(Delegate& delegate, Project& project, const Model
 
 void PropertyEditor::afterEditorCreated()
 {
-	updateProperty(property_, property_);
+	recreateKeys();
 }
 
 const std::unordered_set<Widget*> PropertyEditor::widgets() const
@@ -54,11 +54,17 @@ void PropertyEditor::applyOffset(Frame offset, std::unordered_set<Widget*>& alre
 	updateParentGeometry();
 }
 
-void PropertyEditor::updateProperty(PropertyPtr prevProperty, PropertyPtr curProperty)
+void PropertyEditor::updateProperty(PropertyPtr prevProperty, PropertyPtr curProperty, const Core::Property::KeyChanges* keyChanges)
 {
 	if (prevProperty != property_) return;
 	property_ = curProperty;
 
+	if (keyChanges) patchKeys(*keyChanges);
+	else recreateKeys();
+}
+
+void PropertyEditor::recreateKeys()
+{
 	std::vector<bool> wasSelected;
 
 	for (const auto& key : keys_)
@@ -86,6 +92,43 @@ void PropertyEditor::updateProperty(PropertyPtr prevProperty, PropertyPtr curPro
 	updateParentGeometry();
 }
 
+void PropertyEditor::patchKeys(const Core::Property::KeyChanges& keyChanges)
+{
+	if (keyChanges.empty()) return;
+
+	auto byOriginalFrame = [](const Key* lhs, const Key* rhs) { return lhs->originalFrame() < rhs->originalFrame(); };
+	auto findKey = [&](Frame frame)
+	{
+		auto it = std::lower_bound(cbegin(keys_), cend(keys_), frame, [](const Key* key, Frame frame) { return key->originalFrame() < frame; });
+		assert(it != cend(keys_) && (*it)->originalFrame() == frame);
+		return *it;
+	};
+
+	// Look everything up while keys_ is still sorted, only then start changing frames
+	std::vector<std::pair<Key*, Frame>> moved;
+	for (auto&& move : keyChanges.moved) moved.emplace_back(findKey(move.first), move.second);
+	std::unordered_set<Key*> removed;
+	for (auto&& frame : keyChanges.removed) removed.insert(findKey(frame));
+
+	for (auto&& frame : keyChanges.changed) findKey(frame)->reset(frame, property_->getPropertyValue(frame));
+	for (auto&& move : moved) move.first->reset(move.second, property_->getPropertyValue(move.second));
+
+	for (auto&& key : removed) key->deleteLater();
+	if (!removed.empty()) keys_.erase(std::remove_if(begin(keys_), end(keys_), [&](Key* key) { return removed.count(key) > 0; }), end(keys_));
+	if (!moved.empty()) std::sort(begin(keys_), end(keys_), byOriginalFrame);
+
+	for (auto&& frame : keyChanges.added)
+	{
+		auto key = new Key(frame, property_->getPropertyValue(frame), this);
+		keys_.insert(std::upper_bound(begin(keys_), end(keys_), key, byOriginalFrame), key);
+		key->show();
+
+		emit widgetCreated(key);
+	}
+
+	updateParentGeometry();
+}
+
 void PropertyEditor::updateParentGeometry()
 {
 	auto node = document_->parent(*property_);
@@ -39,13 +39,15 @@ private:
 
 	const std::unordered_set<Widget*> widgets() const override;
 
-	void updateProperty(Core::PropertyPtr prevProperty, Core::PropertyPtr curProperty);
+	void updateProperty(Core::PropertyPtr prevProperty, Core::PropertyPtr curProperty, const Core::Property::KeyChanges* keyChanges);
+	void recreateKeys();
+	void patchKeys(const Core::Property::KeyChanges& keyChanges);
 	void updateDocument(const Core::Document* prev, const Core::Document* cur);
 
 	Core::PropertyPtr property_;
 
 	Core::Frame start_, stop_;
-	std::vector<Property::Key*> keys_;
+	std::vector<Property::Key*> keys_; // sorted by original frame
 };
 
 END_NAMESPACE(Editor) END_NAMESPACE(Modules) END_NAMESPACE(Timeline) END_NAMESPACE(Keyframer) END_NAMESPACE(Editors)
\ No newline at end of file
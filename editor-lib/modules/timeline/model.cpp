@@ -166,7 +166,7 @@ public:
 		emit model_->modelItemNodeMutated(prev, node);
 	}
 
-	void update(PropertyPtr prop)
+	void update(PropertyPtr prop, const Property::KeyChanges* keys = nullptr)
 	{
 		auto prev = prop_;
 		prop_ = prop;
@@ -174,9 +174,12 @@ public:
 		setData(QVariant::fromValue<int>(static_cast<int>(ModelItemDataType::Property)), static_cast<int>(ModelItemRoles::Type));
 		setData(prop->metadata().title().c_str(), Qt::DisplayRole);
 		propertyValueItem_->update(prop.get());
-		emit model_->modelItemPropertyMutated(prev, prop);
+		emit model_->modelItemPropertyMutated(prev, prop, keys);
 	}
 
+	void update(const Core::MutationInfo::Change<NodePtr>& change) { update(change.cur); }
+	void update(const Core::MutationInfo::Change<PropertyPtr>& change) { update(change.cur, change.keys.get()); }
+
 	NodePtr node() const { return node_; }
 	PropertyPtr prop() const { return prop_; }
 	PropertyValueItem* propertyValueItem() const { return propertyValueItem_; }
@@ -224,7 +227,7 @@ QModelIndexList Model::apply(std::shared_ptr<Core::MutationInfo> mutation, const
 		{
 			if (mut.type != ChangeType::Mutated) continue;
 
-			findItem(mut.prev)->update(mut.cur);
+			findItem(mut.prev)->update(mut);
 			mutated.insert({ mut.prev, mut.cur });
 		}
 	};
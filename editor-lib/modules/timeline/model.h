@@ -39,7 +39,8 @@ signals:
 	void propertyChanged(const Core::Property* prop, Core::PropertyValue newValue) const;
 	void documentMutated(const Core::Document* prevDocument, const Core::Document* curDocument) const;
 	void modelItemNodeMutated(Core::NodePtr prevNode, Core::NodePtr curNode) const;
-	void modelItemPropertyMutated(Core::PropertyPtr prevProp, Core::PropertyPtr curProp) const;
+	// keys is null when it is unknown which keys changed
+	void modelItemPropertyMutated(Core::PropertyPtr prevProp, Core::PropertyPtr curProp, const Core::Property::KeyChanges* keys) const;
 
 private:
 	static int findChildIndex(QStandardItem* parent, ModelItem* item) noexcept;
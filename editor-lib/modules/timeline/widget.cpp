@@ -39,16 +39,19 @@ Widget::Widget(QWidget* parent, Project& project)
 
 	tree_->setModel(proxy_);
 	tree_->setSelectionMode(QAbstractItemView::ExtendedSelection);
-	tree_->setItemDelegateForColumn(static_cast<int>(Model::Columns::Value), new PropertyEditors::Delegate(tree_));
+	auto delegate = new PropertyEditors::Delegate(tree_);
+	tree_->setItemDelegateForColumn(static_cast<int>(Model::Columns::Value), delegate);
 
 	connect(tree_, &QTreeView::expanded, keyframer_, &QTreeView::expand);
 	connect(tree_, &QTreeView::collapsed, keyframer_, &QTreeView::collapse);
 	connect(tree_->verticalScrollBar(), &QScrollBar::valueChanged, this, &Widget::syncVerticalScrollBars);
 	connect(keyframer_->verticalScrollBar(), &QScrollBar::valueChanged, this, &Widget::syncVerticalScrollBars);
 
+	// All changes made while an editor is open end up as one entry in the history
 	connect(model_.get(), &Model::propertyChanged, this, [&](const Property* prop, PropertyValue value)
 	{
-		project.mutate([&](Document::Builder& mut)
+		if (!project.inTransaction()) project.beginTransaction("edit " + prop->metadata().title());
+		project.update([&](Document::Builder& mut)
 		{
 			mut.mutate(project.current().parent(*prop), [&](Node::Builder& node)
 			{
@@ -57,7 +60,11 @@ Widget::Widget(QWidget* parent, Project& project)
 					p.set(0, value);
 				});
 			});
-		}, "edit " + prop->metadata().title());
+		});
+	});
+	connect(delegate, &QAbstractItemDelegate::closeEditor, this, [&]()
+	{
+		if (project.inTransaction()) project.commit();
 	});
 }
 
@@ -102,7 +109,7 @@ void Widget::mutate()
 				mut.append({ makeNode(hash("DummyNode"), "a") });
 			},
 			[&](Document::Builder& mut) {
-				mut.mutate(findNode(p, "a"), [&](Node::Builder& node) {
+				mut.mutate(findNode(mut, "a"), [&](Node::Builder& node) {
 					node.mutateProperty(hash("Vec3"), [&](Property::Builder& prop) {
 						prop.set(0, glm::vec3(1, 2, 3));
 						prop.set(100, glm::vec3(100, 200, 300));
@@ -114,7 +121,7 @@ void Widget::mutate()
 	case 1:
 		p.mutate({
 			[&](auto& mut) { mut.insertBefore(findNode(p, "a"), { makeNode(hash("DummyNode"), "b") }); },
-			[&](auto& mut) { mut.insertBefore(findNode(p, "b"), { makeNode(hash("DummyNode"), "c") }); }
+			[&](auto& mut) { mut.insertBefore(findNode(mut, "b"), { makeNode(hash("DummyNode"), "c") }); }
 		}, "create nodes");
 		break;
 	case 2:
@@ -8,6 +8,24 @@ template <typename T>
 using Change = MutationInfo::Change<T>;
 using ChangeType = MutationInfo::ChangeType;
 
+// The changes of both sets are the same, in any order
+template <typename T>
+void assertSameChanges(const MutationInfo::LazyChangeSet<T>& actual, const MutationInfo::LazyChangeSet<T>& expected)
+{
+	AssertThat(actual.size(), Equals(expected.size()));
+	for (auto&& change : expected.get()) AssertThat(actual.get(), Contains(change));
+}
+
+// What the operations of a mutation emit is what diffing its documents emits
+void assertSameAsDiff(const MutationInfo& mutation)
+{
+	MutationInfo diff(mutation.prev, mutation.cur);
+	assertSameChanges(mutation.nodes, diff.nodes);
+	assertSameChanges(mutation.properties, diff.properties);
+	assertSameChanges(mutation.connectors, diff.connectors);
+	assertSameChanges(mutation.connections, diff.connections);
+}
+
 go_bandit([]() {
 	describe("mutation:", [&]()
 	{
@@ -69,6 +87,20 @@ go_bandit([]() {
 			AssertThat(mutation->properties, Contains(Change<PropertyPtr>(prop(*p->a[0], "string"), prop(*p->a[3], "string"), ChangeType::Mutated, p->a[0], p->a[3], 5, 5)));
 		});
 
+		it("should emit changed keys", [&]()
+		{
+			auto mutation = mutations.at(3);
+			for (auto&& change : mutation->properties)
+			{
+				AssertThat(change.keys == nullptr, Equals(false));
+				AssertThat(change.keys->added, Equals(std::vector<Frame> { 100 }));
+				AssertThat(change.keys->removed.empty() && change.keys->moved.empty() && change.keys->changed.empty(), Equals(true));
+			}
+
+			mutation = mutations.at(10);
+			AssertThat(mutation->properties.at(0).keys->empty(), Equals(true));
+		});
+
 		it("should emit added connectors", [&]()
 		{
 			auto mutation = mutations.at(4);
@@ -244,5 +276,39 @@ go_bandit([]() {
 			AssertThat(mutation->nodes, Contains(Change<NodePtr>(p->c[30], p->c[30], ChangeType::Mutated, p->root(), p->root(), 0, 2)));
 			AssertThat(mutation->nodes, Contains(Change<NodePtr>(p->d[30], nullptr, ChangeType::Removed, p->root(), nullptr, 1, -1)));
 		});
+
+		it("should emit the same changes as diffing the documents", [&]()
+		{
+			for (auto&& mutation : mutations) assertSameAsDiff(*mutation);
+		});
+
+		it("should emit the same changes as diffing the documents when appending, erasing, moving and mutating at once", [&]()
+		{
+			auto a = p->a[31], b = p->b[31], c = p->c[31];
+			auto e = makeNode(hash("TestNode"), "e");
+			p->mutate([&](Document::Builder& mut)
+			{
+				mut.append({ e });
+				mut.erase({ c });
+				mut.moveAfter(e, { a });
+				mut.mutate(b, [&](Node::Builder& node)
+				{
+					node.mutateProperty(hash("int"), [&](Property::Builder& prop) { prop.set(200, 7); });
+					node.addConnector(ConnectorMetadata::Builder("Bar", ConnectorType::Input));
+				});
+			});
+			p->undo();
+			p->redo();
+
+			AssertThat(mutations.size(), Equals(MutationProject::NUM_MUTATIONS + 3));
+			for (size_t t = MutationProject::NUM_MUTATIONS; t < mutations.size(); t++)
+			{
+				auto& mutation = *mutations[t];
+				AssertThat(mutation.nodes.empty(), Equals(false));
+				AssertThat(mutation.properties.empty(), Equals(false));
+				AssertThat(mutation.connectors.empty(), Equals(false));
+				assertSameAsDiff(mutation);
+			}
+		});
 	});
 });
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "static.h"
+#include <fstream>
 
 using namespace bandit;
 #include "test-utils.h"
@@ -75,5 +76,65 @@ go_bandit([]() {
 
 			TestNode::assertKeyframes(node_a);
 		});
+
+		it("should restore from the autosave journal", [&]()
+		{
+			const std::string path = "serializer.spec";
+			{
+				Journal journal(path);
+				journal.snapshot(p->root(), p->current());
+				p->setJournalCallback([&](auto& delta, bool inverse) { journal.append(delta, inverse); });
+
+				p->mutate([&](auto& mut) { mut.append({ makeNode(hash("TestNode"), "d") }); });
+				p->mutate([&](auto& mut) { mut.erase({ findNode(*p, "d") }); });
+				p->undo();
+				p->mutate([&](Document::Builder& mut)
+				{
+					mut.mutate(findNode(mut, "b"), [&](Node::Builder& node)
+					{
+						node.mutateProperty(hash("int"), [&](Property::Builder& prop) { prop.set(0, 7); });
+					});
+				});
+
+				p->setJournalCallback(nullptr);
+				journal.flush();
+			}
+
+			p2 = std::make_unique<Project>();
+			AssertThat(Journal::restore(path, *p2), Equals(true));
+			Journal::remove(path);
+
+			auto node_b = findNode(*p2, "b");
+			AssertThat(findNode(*p2, "d") == nullptr, Equals(false));
+			AssertThat(prop(*node_b, "int")->get<int>(0), Equals(7));
+			AssertThat(p2->current().parent(*node_b) == findNode(*p2, "c"), Equals(true));
+			AssertThat(p2->current().connections().size(), Equals(1));
+			AssertThat(p2->current().connections()[0]->inputNode() == node_b, Equals(true));
+			AssertThat(p2->current().connections()[0]->outputNode() == findNode(*p2, "a"), Equals(true));
+		});
+
+		it("doesn't restore a damaged autosave", [&]()
+		{
+			const std::string path = "serializer.spec";
+			{
+				Journal journal(path);
+				journal.snapshot(p->root(), p->current());
+				journal.flush();
+			}
+
+			// Cut off halfway, as a crash while writing would
+			std::string snapshot;
+			{
+				std::ifstream in(path + ".autosave", std::ios::binary);
+				snapshot.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			}
+			std::ofstream(path + ".autosave", std::ios::binary | std::ios::trunc) << snapshot.substr(0, snapshot.size() / 2);
+
+			p2 = std::make_unique<Project>();
+			auto empty = p2->current();
+			AssertThat(Journal::restore(path, *p2), Equals(false));
+			AssertThat(p2->current() == empty, Equals(true));
+			Journal::remove(path);
+		});
 	});
 });
\ No newline at end of file
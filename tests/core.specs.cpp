@@ -33,6 +33,27 @@ go_bandit([]() {
 			AssertThat(findNode(*p, "b") == nullptr, Equals(true));
 		});
 
+		it("compares documents by their nodes", [&]()
+		{
+			Document base = p->current();
+			auto a = makeNode(hash("TestNode"), "a");
+			auto b = makeNode(hash("TestNode"), "b");
+
+			Document::Builder together(base);
+			together.append({ a, b });
+			Document::Builder apart(base);
+			apart.append({ a });
+			apart.append({ b });
+			Document::Builder swapped(base);
+			swapped.append({ b });
+			swapped.append({ a });
+
+			Document ab(std::move(together)), ab2(std::move(apart)), ba(std::move(swapped));
+			AssertThat(ab == ab2, Equals(true));
+			AssertThat(ab == ba, Equals(false));
+			AssertThat(ab == base, Equals(false));
+		});
+
 		it("allows grouping nodes", [&]()
 		{
 			AssertThat(p->current().totalChildCount(*p->root()), Equals(0));
@@ -65,6 +86,269 @@ go_bandit([]() {
 			AssertThat(p->current().totalChildCount(*p->root()), Equals(4));
 		});
 
+		it("can look up nodes", [&]()
+		{
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a"), makeNode(hash("TestNode"), "b") }); });
+			auto a = findNode(*p, "a");
+			auto b = findNode(*p, "b");
+			AssertThat(p->current().find(a->uuid()), Equals(a));
+			AssertThat(p->current().exists(*b), Equals(true));
+			AssertThat(p->current().childIndex(*b), Equals(1));
+			AssertThat(p->current().childCount(*p->root()), Equals(2));
+
+			p->mutate([&](auto& mut) { mut.erase({ a }); });
+			AssertThat(p->current().find(a->uuid()) == nullptr, Equals(true));
+			AssertThat(p->current().exists(*a), Equals(false));
+			AssertThat(p->current().childIndex(*b), Equals(0));
+			AssertThat(p->current().childCount(*p->root()), Equals(1));
+		});
+
+		it("keeps nodes in order", [&]()
+		{
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a"), makeNode(hash("TestNode"), "b"), makeNode(hash("TestNode"), "c") }); });
+			auto a = findNode(*p, "a");
+			auto b = findNode(*p, "b");
+			auto c = findNode(*p, "c");
+			p->mutate([&](auto& mut) { mut.moveAfter(a, { c }); });
+			AssertThat(p->current().child(*p->root(), 1), Equals(c));
+			AssertThat(p->current().child(*p->root(), 2), Equals(b));
+
+			p->mutate([&](auto& mut) { mut.reparent(p->root(), { a }); });
+			AssertThat(p->current().child(*p->root(), 2), Equals(a));
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(3));
+
+			p->undo();
+			AssertThat(p->current().child(*p->root(), 0), Equals(a));
+		});
+
+		it("can mutate nodes in bulk", [&]()
+		{
+			std::vector<NodePtr> nodes;
+			for (int t = 0; t < 100; t++) nodes.emplace_back(makeNode(hash("TestNode"), std::to_string(t)));
+			p->mutate([&](auto& mut) { mut.append(nodes); });
+			AssertThat(p->current().childCount(*p->root()), Equals(100));
+
+			auto group = findNode(*p, "0");
+			p->mutate([&](auto& mut) { mut.reparent(group, cbegin(nodes) + 50, cend(nodes)); });
+			AssertThat(p->current().childCount(*p->root()), Equals(50));
+			AssertThat(p->current().childIndex(*findNode(*p, "99")), Equals(49));
+
+			p->mutate([&](auto& mut) { mut.moveAfter(findNode(*p, "40"), { group }); });
+			AssertThat(p->current().nodes().childIndex(group->uuid()), Equals(40));
+			AssertThat(p->current().nodes().childIndex(findNode(*p, "41")->uuid()), Equals(41));
+			p->undo();
+			AssertThat(p->current().nodes().childIndex(group->uuid()), Equals(0));
+			AssertThat(p->current().nodes().childIndex(findNode(*p, "41")->uuid()), Equals(41));
+
+			p->mutate([&](auto& mut) { mut.erase(cbegin(nodes) + 1, cend(nodes)); });
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(1));
+			p->undo();
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(100));
+		});
+
+		it("builds on earlier steps of the same mutation", [&]()
+		{
+			auto a = makeNode(hash("TestNode"), "a");
+			p->mutate({
+				[&](auto& mut) { mut.append({ a }); },
+				[&](auto& mut) { mut.mutate(a, [](Node::Builder& node) { node.mutateProperty(hash("int"), [](Property::Builder& prop) { prop.set(0, 1); }); }); },
+				[&](auto& mut) { mut.mutate(a, [](Node::Builder& node) { node.mutateProperty(hash("int"), [](Property::Builder& prop) { prop.set(10, 2); }); }); },
+				[&](auto& mut) { mut.append(findNode(mut, "a"), { makeNode(hash("TestNode"), "b") }); }
+			});
+
+			auto current = p->current().find(a->uuid());
+			AssertThat(prop(*current, "int")->get<int>(0), Equals(1));
+			AssertThat(prop(*current, "int")->get<int>(10), Equals(2));
+			AssertThat(p->current().childCount(*current), Equals(1));
+
+			p->undo();
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(0));
+		});
+
+		it("can compare documents", [&]()
+		{
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a"), makeNode(hash("TestNode"), "b") }); });
+			auto original = p->current();
+			AssertThat(p->current() == original, Equals(true));
+
+			p->mutate([&](auto& mut) { mut.moveAfter(findNode(*p, "b"), { findNode(*p, "a") }); });
+			AssertThat(p->current() == original, Equals(false));
+
+			// Same structure built in a different way
+			p->mutate([&](auto& mut) { mut.moveAfter(findNode(*p, "a"), { findNode(*p, "b") }); });
+			AssertThat(p->current() == original, Equals(true));
+		});
+
+		it("only reports the categories that were asked for", [&]()
+		{
+			std::vector<std::shared_ptr<MutationInfo>> mutations;
+			p->setMutationCallback([&](auto mutationInfo) { mutations.emplace_back(mutationInfo); }, MutationInfo::Category::Connections | MutationInfo::Category::Settings);
+
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a") }); });
+			AssertThat(mutations.size(), Equals(0));
+
+			p->mutate([](auto& mut) { mut.mutateSettings({ { 0, 100 } }); });
+			AssertThat(mutations.size(), Equals(1));
+			AssertThat(mutations[0]->categories() == MutationInfo::Category::Settings, Equals(true));
+			AssertThat(mutations[0]->nodes.empty(), Equals(true));
+		});
+
+		it("reports changes in order for large documents", [&]()
+		{
+			std::shared_ptr<MutationInfo> mutation;
+			p->setMutationCallback([&](auto mutationInfo) { mutation = mutationInfo; });
+
+			std::vector<NodePtr> nodes;
+			for (int t = 0; t < 5000; t++) nodes.emplace_back(makeNode(hash("TestNode"), std::to_string(t)));
+			p->mutate([&](auto& mut) { mut.append(nodes); });
+
+			auto numProperties = nodes[0]->properties().size();
+			AssertThat(mutation->properties.size(), Equals(nodes.size() * numProperties));
+			bool ordered = true;
+			for (size_t t = 0; t < mutation->properties.size(); t++) ordered &= mutation->properties[t].curParent == nodes[t / numProperties];
+			AssertThat(ordered, Equals(true));
+		});
+
+		it("can report mutations in the background", [&]()
+		{
+			std::vector<std::shared_ptr<MutationInfo>> mutations;
+			std::vector<std::thread::id> threads;
+			p->setMutationCallback([&](auto mutationInfo)
+			{
+				mutations.emplace_back(mutationInfo);
+				threads.emplace_back(std::this_thread::get_id());
+			}, MutationInfo::Category::All, Project::Dispatch::Background);
+
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a") }); });
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "b"), makeNode(hash("TestNode"), "c") }); });
+			p->undo();
+			p->waitForMutations();
+
+			AssertThat(mutations.size(), Equals(3));
+			AssertThat(mutations[0]->nodes.size(), Equals(1));
+			AssertThat(mutations[1]->nodes.size(), Equals(2));
+			AssertThat(mutations[2]->nodes[0].type == MutationInfo::ChangeType::Removed, Equals(true));
+			AssertThat(mutations[2]->cur.totalChildCount(*p->root()), Equals(1));
+			AssertThat(threads[0] != std::this_thread::get_id(), Equals(true));
+		});
+
+		it("can coalesce continuous edits", [&]()
+		{
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a") }); });
+			auto a = findNode(*p, "a");
+
+			std::vector<std::shared_ptr<MutationInfo>> mutations;
+			p->setMutationCallback([&](auto mutationInfo) { mutations.emplace_back(mutationInfo); });
+
+			p->beginTransaction("scrub");
+			for (int t = 0; t < 10; t++)
+			{
+				p->update([&](Document::Builder& mut)
+				{
+					mut.mutate(p->current().find(a->uuid()), [&](Node::Builder& node)
+					{
+						node.mutateProperty(hash("int"), [&](Property::Builder& prop) { prop.set(0, t); });
+					});
+				});
+			}
+			p->commit();
+
+			AssertThat(mutations.size(), Equals(10));
+			AssertThat(mutations.back()->properties.size(), Equals(1));
+			AssertThat(prop(*p->current().find(a->uuid()), "int")->get<int>(0), Equals(9));
+			AssertThat(p->undoState().undoDescription, Equals("scrub"));
+
+			p->undo();
+			AssertThat(p->current().find(a->uuid()), Equals(a));
+			AssertThat(mutations.back()->properties.size(), Equals(1));
+			p->redo();
+			AssertThat(prop(*p->current().find(a->uuid()), "int")->get<int>(0), Equals(9));
+
+			p->beginTransaction();
+			p->update([&](Document::Builder& mut) { mut.erase({ p->current().find(a->uuid()) }); });
+			p->cancel();
+			AssertThat(p->current().find(a->uuid()) == nullptr, Equals(false));
+			AssertThat(mutations.back()->nodes.size(), Equals(1));
+
+			// A mutation in the middle of an edit ends the edit first
+			p->beginTransaction("drag");
+			p->update([&](Document::Builder& mut) { mut.erase({ p->current().find(a->uuid()) }); });
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "b") }); }, "add");
+			AssertThat(p->inTransaction(), Equals(false));
+			AssertThat(p->undoState().undoDescription, Equals("add"));
+			p->undo();
+			AssertThat(p->undoState().undoDescription, Equals("drag"));
+			p->undo();
+			AssertThat(p->current().find(a->uuid()) == nullptr, Equals(false));
+		});
+
+		it("keeps the history within its budget", [&]()
+		{
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a") }); });
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "b") }); });
+			p->mutate([&](auto& mut) { mut.reparent(findNode(*p, "a"), { findNode(*p, "b") }); });
+			AssertThat(p->historyMemoryUsage() > 0, Equals(true));
+
+			p->undo();
+			AssertThat(p->current().parent(*findNode(*p, "b")), Equals(p->root()));
+			p->redo();
+			AssertThat(p->current().parent(*findNode(*p, "b")), Equals(findNode(*p, "a")));
+
+			// Redo counts towards the budget as well, the entry furthest away from the current document goes first
+			p->undo();
+			auto usage = p->historyMemoryUsage();
+			p->setHistoryBudget(usage - 1);
+			AssertThat(p->undoState().canUndo, Equals(true));
+			AssertThat(p->undoState().canRedo, Equals(true));
+			AssertThat(p->historyMemoryUsage() <= usage - 1, Equals(true));
+
+			auto current = p->current();
+			p->setHistoryBudget(0);
+			AssertThat(p->undoState().canUndo, Equals(false));
+			AssertThat(p->undoState().canRedo, Equals(false));
+			AssertThat(p->current() == current, Equals(true));
+
+			// Only what is left of the oldest entry, which holds no changes anymore
+			usage = p->historyMemoryUsage();
+			p->setHistoryBudget(Project::DEFAULT_HISTORY_BUDGET);
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "c") }); });
+			AssertThat(p->historyMemoryUsage() > usage, Equals(true));
+			p->setHistoryBudget(usage);
+			AssertThat(p->historyMemoryUsage() <= usage, Equals(true));
+		});
+
+		it("can page old history out to disk", [&]()
+		{
+			p->setResidentHistory(1);
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a"), makeNode(hash("TestNode"), "b") }); });
+			auto a = findNode(*p, "a");
+			auto b = findNode(*p, "b");
+			p->mutate([&](auto& mut) { mut.reparent(a, { b }); });
+			p->mutate([&](auto& mut)
+			{
+				mut.mutate(a, [](Node::Builder& node) { node.mutateProperty(hash("int"), [](Property::Builder& prop) { prop.set(0, 5); }); });
+			});
+			p->mutate([&](auto& mut) { mut.erase({ p->current().find(a->uuid()) }); });
+			AssertThat(p->historyDiskUsage() > 0, Equals(true));
+
+			p->undo();
+			AssertThat(prop(*p->current().find(a->uuid()), "int")->get<int>(0), Equals(5));
+			AssertThat(p->current().parent(*p->current().find(b->uuid()))->uuid(), Equals(a->uuid()));
+			p->undo();
+			AssertThat(prop(*p->current().find(a->uuid()), "int")->get<int>(0), Equals(prop(*a, "int")->get<int>(0)));
+			p->undo();
+			AssertThat(p->current().parent(*p->current().find(b->uuid())), Equals(p->root()));
+			p->undo();
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(0));
+			AssertThat(p->historyDiskUsage(), Equals(0));
+
+			for (int t = 0; t < 4; t++) p->redo();
+			AssertThat(p->current().find(a->uuid()) == nullptr, Equals(true));
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(0));
+			p->undo();
+			AssertThat(p->current().totalChildCount(*p->root()), Equals(2));
+		});
+
 		it("can reset", [&]()
 		{
 			const int NUM_ITERATIONS = 10;
@@ -128,6 +412,135 @@ go_bandit([]() {
 			TestNode::assertKeyframes(findNode(*p, "a"));
 		});
 
+		it("can tell which keys changed", [&]()
+		{
+			auto prev = std::make_shared<Property>(*prop(*findNode(*p, "a"), "int"));
+			Property::Builder builder(*prev);
+			for (int t = 0; t < 5; t++) builder.set(static_cast<Frame>(t * 10), t);
+			prev = std::make_shared<Property>(std::move(builder));
+
+			builder = Property::Builder(*prev);
+			builder.erase(10);
+			builder.set(15, 1); // 10 moved to 15
+			builder.set(20, 200); // changed
+			builder.erase(30); // removed
+			builder.set(50, 5); // added
+			auto cur = std::make_shared<Property>(std::move(builder));
+
+			auto changes = Property::diffKeys(*prev, *cur);
+			AssertThat(changes.moved, Equals(std::vector<std::pair<Frame, Frame>> { { 10.f, 15.f } }));
+			AssertThat(changes.changed, Equals(std::vector<Frame> { 20 }));
+			AssertThat(changes.removed, Equals(std::vector<Frame> { 30 }));
+			AssertThat(changes.added, Equals(std::vector<Frame> { 50 }));
+			AssertThat(Property::diffKeys(*cur, *cur).empty(), Equals(true));
+		});
+
+		it("keeps keys in frame order", [&]()
+		{
+			Property::Builder builder(*prop(*findNode(*p, "a"), "double"));
+			builder.set(30, 3.0);
+			builder.set(10, 1.0);
+			builder.set(std::vector<Frame> { 40, 20, 10, 40 }, std::vector<double> { 0.0, 2.0, 10.0, 4.0 });
+			builder.erase(0);
+			Property property(std::move(builder));
+
+			AssertThat(property.keys(), Equals(Property::keys_t { 10, 20, 30, 40 }));
+			AssertThat(property.get<double>(10), Equals(10.0));
+			AssertThat(property.get<double>(40), Equals(4.0));
+			AssertThat(property.get<double>(25), Equals(2.5));
+		});
+
+		it("can evaluate many frames at once", [&]()
+		{
+			p->mutate([&](Document::Builder& mut)
+			{
+				TestNode::addKeyframes(mut, findNode(*p, "a"));
+				mut.mutate(findNode(mut, "a"), [&](Node::Builder& node)
+				{
+					node.mutateProperty(hash("double"), [&](Property::Builder& prop) { prop.set(40, 100.0); prop.set(41, -3.0); });
+				});
+			});
+			auto property = prop(*findNode(*p, "a"), "double");
+
+			std::vector<Frame> frames { -10, 0, 0.5f, 39, 40, 40.25f, 41, 77, 100, 120, 3, 40.5f };
+			std::vector<double> values(frames.size());
+			property->evaluate(frames.data(), frames.size(), values.data());
+			for (size_t t = 0; t < frames.size(); t++) AssertThat(values[t], Equals(property->get<double>(frames[t])));
+
+			std::vector<glm::vec3> steps(400);
+			prop(*findNode(*p, "a"), "vec3")->evaluate(-50.f, 0.5f, steps.size(), steps.data());
+			for (size_t t = 0; t < steps.size(); t++) AssertThat(steps[t], Equals(prop(*findNode(*p, "a"), "vec3")->get<glm::vec3>(-50.f + t * 0.5f)));
+		});
+
+		it("can play back a property", [&]()
+		{
+			p->mutate([&](Document::Builder& mut) { TestNode::addKeyframes(mut, findNode(*p, "a")); });
+			auto property = prop(*findNode(*p, "a"), "vec2");
+			Property::Cursor<glm::vec2> cursor(*property);
+
+			bool same = true;
+			for (Frame frame = -20; frame < 130; frame += 0.25f) same &= cursor(frame) == property->get<glm::vec2>(frame);
+			for (Frame frame : { 100.f, 50.f, 0.f, -1.f, 75.5f }) same &= cursor(frame) == property->get<glm::vec2>(frame);
+			AssertThat(same, Equals(true));
+		});
+
+		it("bakes properties that are evaluated densely", [&]()
+		{
+			auto& cache = BakeCache::instance();
+			auto usage = cache.memoryUsage();
+
+			Property::Builder builder(*prop(*findNode(*p, "a"), "vec3"));
+			for (int t = 0; t < 10; t++) builder.set(static_cast<Frame>(t * 30), glm::vec3(t, t * t, -t));
+			auto property = std::make_unique<Property>(std::move(builder));
+
+			// A single frame isn't dense, it is evaluated from the keys
+			glm::vec3 single;
+			property->evaluate(10.f, 1.f, 1, &single);
+			AssertThat(single == property->get<glm::vec3>(10.f), Equals(true));
+			AssertThat(cache.memoryUsage(), Equals(usage));
+
+			bool same = true;
+			for (int pass = 0; pass < 2; pass++)
+			{
+				std::vector<glm::vec3> values(400);
+				property->evaluate(-20.f, 1.f, values.size(), values.data());
+				for (size_t t = 0; t < values.size(); t++) same &= values[t] == property->get<glm::vec3>(-20.f + t);
+			}
+			AssertThat(same, Equals(true));
+			AssertThat(cache.memoryUsage() > usage, Equals(true));
+
+			property.reset();
+			AssertThat(cache.memoryUsage(), Equals(usage));
+
+			cache.setBudget(0);
+			AssertThat(cache.memoryUsage(), Equals(0u));
+			cache.setBudget(BakeCache::DEFAULT_BUDGET);
+		});
+
+		it("knows when it holds still", [&]()
+		{
+			AssertThat(findNode(*p, "a")->isTimeInvariant(-100, 100), Equals(true));
+
+			p->mutate([&](Document::Builder& mut)
+			{
+				mut.mutate(findNode(mut, "a"), [&](Node::Builder& node)
+				{
+					node.mutateProperty(hash("double"), [&](Property::Builder& prop) { prop.set(0, 5.0); prop.set(10, 5.0); prop.set(20, 5.0); prop.set(30, 8.0); });
+					node.mutateProperty(hash("string"), [&](Property::Builder& prop) { prop.set(0, "a"); prop.set(25, "b"); });
+				});
+			});
+			auto a = findNode(*p, "a");
+			constexpr auto infinity = std::numeric_limits<Frame>::infinity();
+
+			AssertThat(prop(*a, "double")->constantIntervals(), Equals(Property::intervals_t { { -infinity, 20 }, { 30, infinity } }));
+			AssertThat(prop(*a, "string")->constantIntervals().size(), Equals(2));
+			AssertThat(prop(*a, "string")->isConstant(0, 24.5f), Equals(true));
+			AssertThat(prop(*a, "string")->isConstant(0, 25), Equals(false));
+			AssertThat(a->isTimeInvariant(-50, 20), Equals(true));
+			AssertThat(a->isTimeInvariant(15, 21), Equals(false));
+			AssertThat(a->isTimeInvariant(40, 1000), Equals(true));
+		});
+
 		it("can add a connector", [&]()
 		{
 			p->mutate([&](Document::Builder& mut)
@@ -146,6 +559,107 @@ go_bandit([]() {
 		});
 	});
 
+	describe("evaluator:", []()
+	{
+		std::unique_ptr<Project> p;
+		std::unique_ptr<Evaluator> evaluator;
+
+		before_each([&]()
+		{
+			p = std::make_unique<Project>();
+			p->mutate([](auto& mut) { mut.append({ makeNode(hash("TestNode"), "a"), makeNode(hash("TestNode"), "b") }); });
+			p->mutate([&](Document::Builder& mut) { TestNode::addKeyframes(mut, findNode(mut, "a")); });
+
+			evaluator = std::make_unique<Evaluator>(p->current());
+			p->setMutationCallback([&](auto mutationInfo) { evaluator->update(*mutationInfo); });
+		});
+
+		// Every property evaluates to the same value as on its own
+		auto matches = [&](Frame frame, Evaluator::Result& result)
+		{
+			bool same = true;
+			for (auto&& node : p->current().nodes())
+			{
+				for (auto&& property : node->properties())
+				{
+					auto slot = evaluator->slot(node->uuid(), property->propertyType());
+					if (!slot) return false;
+
+					auto value = property->getPropertyValue(frame);
+					switch (slot->type)
+					{
+					case Evaluator::Type::Int: same &= result.get<int>(*slot) == *value.target<int>(); break;
+					case Evaluator::Type::Double: same &= result.get<double>(*slot) == *value.target<double>(); break;
+					case Evaluator::Type::Vec2: same &= result.get<glm::vec2>(*slot) == *value.target<glm::vec2>(); break;
+					case Evaluator::Type::Vec3: same &= result.get<glm::vec3>(*slot) == *value.target<glm::vec3>(); break;
+					case Evaluator::Type::String: same &= result.get<std::string>(*slot) == *value.target<std::string>(); break;
+					}
+				}
+			}
+			return same;
+		};
+
+		it("evaluates every property at once", [&]()
+		{
+			Evaluator::Result result;
+			Evaluator::Cursor cursor;
+			bool same = true;
+			for (Frame frame = -10; frame < 110; frame += 0.5f)
+			{
+				evaluator->evaluate(frame, result, cursor);
+				same &= matches(frame, result);
+			}
+			evaluator->evaluate(25, result, cursor);
+			AssertThat(same && matches(25, result), Equals(true));
+		});
+
+		it("evaluates many frames in parallel", [&]()
+		{
+			for (auto&& frames : { Evaluator::FrameSet::range(-20, 120, 1.f / 16), Evaluator::FrameSet({ 50, 3.5f, 99, -1, 50.25f }) })
+			{
+				std::vector<Evaluator::Result> results(frames.size());
+				evaluator->evaluate(frames, results.data());
+
+				bool same = true;
+				for (size_t t = 0; t < frames.size(); t++) same &= matches(frames[t], results[t]);
+				AssertThat(same, Equals(true));
+			}
+
+			AssertThat(Evaluator::FrameSet::range(0, 10, 2.5f).size(), Equals(5));
+			AssertThat(Evaluator::FrameSet::range(10, 0).size(), Equals(0));
+			AssertThat(Evaluator::FrameSet::range(0, std::numeric_limits<Frame>::quiet_NaN()).size(), Equals(0));
+			AssertThat(Evaluator::FrameSet::range(0, std::numeric_limits<Frame>::infinity()).size(), Equals(0));
+		});
+
+		it("follows mutations", [&]()
+		{
+			Evaluator::Result result;
+			for (int t = 0; t < 20; t++)
+			{
+				p->mutate([&](Document::Builder& mut)
+				{
+					mut.mutate(findNode(mut, "a"), [&](Node::Builder& node)
+					{
+						node.mutateProperty(hash("double"), [&](Property::Builder& prop) { prop.set(static_cast<Frame>(t * 5), t * 10.0); });
+					});
+				});
+			}
+			evaluator->evaluate(42.5f, result);
+			AssertThat(matches(42.5f, result), Equals(true));
+
+			p->mutate([&](auto& mut) { mut.erase({ findNode(mut, "b") }); });
+			p->mutate([&](auto& mut) { mut.append({ makeNode(hash("TestNode"), "c") }); });
+			p->mutate([&](Document::Builder& mut) { TestNode::addKeyframes(mut, findNode(mut, "c")); });
+			evaluator->evaluate(60, result);
+			AssertThat(matches(60, result), Equals(true));
+
+			p->undo();
+			p->undo();
+			evaluator->evaluate(70.25f, result);
+			AssertThat(matches(70.25f, result), Equals(true));
+		});
+	});
+
 	describe("connection:", [&]()
 	{
 		std::unique_ptr<Project> p;
@@ -208,5 +722,17 @@ go_bandit([]() {
 				AssertThat(p->current().connections()[0]->outputNode() == node_a, Equals(true));
 			});
 		});
+
+		it("should disconnect when erasing a parent", [&]()
+		{
+			p->mutate([&](auto& mut) { mut.append({ makeNode(hash("TestNode"), "g") }); });
+			p->mutate([&](auto& mut) { mut.reparent(findNode(*p, "g"), { findNode(*p, "b") }); });
+			AssertThat(p->current().connections().size(), Equals(1));
+
+			p->mutate([&](auto& mut) { mut.erase({ findNode(*p, "g") }); });
+			AssertThat(p->current().connections().size(), Equals(0));
+			p->undo();
+			AssertThat(p->current().connections()[0]->inputNode() == findNode(*p, "b"), Equals(true));
+		});
 	});
 });
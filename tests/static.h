@@ -1,9 +1,11 @@
 #pragma once
 
 #include <bandit/bandit.h>
-#include <tree/tree_util.h>
 
+#include <core/bake_cache.h>
+#include <core/evaluator.h>
 #include <core/factory.h>
+#include <core/journal.h>
 #include <core/metadata.h>
 #include <core/node.h>
 #include <core/project.h>